@@ -0,0 +1,419 @@
+#include "AMBE.h"
+
+#include <string.h>
+#include <endian.h>
+#include <pthread.h>
+
+const uint8_t AMBESilenceLinear[LINEAR_FRAME_SIZE] = { 0xf8, 0x01, 0xa9, 0x9f, 0x8c, 0xe0, 0x80 };
+const uint8_t AMBESilenceMode33[MODE33_FRAME_SIZE] = { 0xb9, 0xe8, 0x81, 0x52, 0x61, 0x73, 0x00, 0x2a, 0x6b };
+
+int ClassifyAMBEFrame(const uint8_t* frame, size_t size)
+{
+  switch (size)
+  {
+    case DSD_AMBE_CHUNK_SIZE:
+      // DSD keeps the number of corrected bit errors in the first byte and the 49th bit in the LSB of the last one
+      if (frame[0] != 0)
+        return AMBE_FRAME_ERASURE;
+      if ((memcmp(frame + 1, AMBESilenceLinear, LINEAR_FRAME_SIZE - 1) == 0) &&
+          ((frame[LINEAR_FRAME_SIZE] & 1) == (AMBESilenceLinear[LINEAR_FRAME_SIZE - 1] >> 7)))
+        return AMBE_FRAME_SILENCE;
+      break;
+
+    case LINEAR_FRAME_SIZE:
+      if (memcmp(frame, AMBESilenceLinear, LINEAR_FRAME_SIZE) == 0)
+        return AMBE_FRAME_SILENCE;
+      break;
+
+    case MODE33_FRAME_SIZE:
+      if (memcmp(frame, AMBESilenceMode33, MODE33_FRAME_SIZE) == 0)
+        return AMBE_FRAME_SILENCE;
+      break;
+  }
+
+  return AMBE_FRAME_VOICE;
+}
+
+// Silence filter
+
+void InitializeSilenceFilter(struct SilenceFilter* filter, size_t size, size_t limit)
+{
+  memset(filter, 0, sizeof(struct SilenceFilter));
+  filter->size  = size;
+  filter->limit = limit;
+}
+
+size_t FilterSilenceFrames(struct SilenceFilter* filter, uint8_t* data, size_t count)
+{
+  size_t size = filter->size;
+  size_t index;
+  size_t kept;
+
+  filter->frames += count;
+
+  if (filter->limit == 0)
+    return count;
+
+  for (index = 0, kept = 0; index < count; index ++)
+  {
+    if (ClassifyAMBEFrame(data + index * size, size) != AMBE_FRAME_SILENCE)
+      filter->run = 0;
+    else if ((++ filter->run) > filter->limit)
+    {
+      filter->dropped ++;
+      filter->runs += (filter->run == (filter->limit + 1));
+      continue;
+    }
+
+    if (kept != index)
+      memcpy(data + kept * size, data + index * size, size);
+
+    kept ++;
+  }
+
+  return kept;
+}
+
+size_t ReadFilteredFrames(struct InputStream* stream, struct SilenceFilter* filter, uint8_t* buffer, size_t count)
+{
+  size_t length;
+  size_t total;
+
+  if (filter == NULL)
+    return ReadInputFrames(stream, buffer, count);
+
+  // Dropped frames leave a gap at the end, refill it until the request is met
+
+  for (total = 0; total < count; total += FilterSilenceFrames(filter, buffer + total * stream->size, length))
+  {
+    length = ReadInputFrames(stream, buffer + total * stream->size, count - total);
+
+    if (length == 0)
+      break;
+  }
+
+  return total;
+}
+
+// Transcoder
+
+#define GOLAY_POLYNOMIAL   0xc75
+#define GOLAY_DATA_SIZE    4096
+#define GOLAY_SYNDROMES    2048
+
+#define FIELD_A_SIZE       24
+#define FIELD_B_SIZE       23
+#define FIELD_C_SIZE       25
+
+#define CHUNK_COUNT        10
+
+struct AMBEFields
+{
+  uint32_t a;
+  uint32_t b;
+  uint32_t c;
+};
+
+struct AMBEPattern
+{
+  uint64_t head;  // Bits 0-63 of mode 33 frame
+  uint8_t tail;   // Bits 64-71
+};
+
+// Positions of field bits in mode 33 frame, most significant bit first
+
+static const uint8_t positionsA[FIELD_A_SIZE] =
+{
+   0,  4,  8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60, 64, 68,
+   1,  5,  9, 13, 17, 21
+};
+
+static const uint8_t positionsB[FIELD_B_SIZE] =
+{
+  25, 29, 33, 37, 41, 45, 49, 53, 57, 61, 65, 69,
+   2,  6, 10, 14, 18, 22, 26, 30, 34, 38, 42
+};
+
+static const uint8_t positionsC[FIELD_C_SIZE] =
+{
+  46, 50, 54, 58, 62, 66, 70,
+   3,  7, 11, 15, 19, 23, 27, 31, 35, 39, 43, 47, 51, 55, 59, 63, 67, 71
+};
+
+static pthread_once_t initialization = PTHREAD_ONCE_INIT;
+
+static uint32_t encodings[GOLAY_DATA_SIZE];     // Golay(23,12) codeword by data
+static uint32_t corrections[GOLAY_SYNDROMES];   // Error pattern by syndrome
+static uint32_t masks[GOLAY_DATA_SIZE];         // Scrambling of B by data of A
+
+static struct AMBEFields fields[MODE33_FRAME_SIZE][256];
+static struct AMBEPattern patterns[CHUNK_COUNT][256];
+
+static uint32_t CalculateGolayCodeword(uint32_t data)
+{
+  uint32_t value = data << 11;
+  int index;
+
+  for (index = 22; index >= 11; index --)
+    if (value & (1 << index))
+      value ^= GOLAY_POLYNOMIAL << (index - 11);
+
+  return (data << 11) | value;
+}
+
+static void AddInterleaving(int chunk, const uint8_t* positions, size_t size, int first)
+{
+  struct AMBEPattern* pattern;
+  int position;
+  int value;
+  int bit;
+
+  for (value = 0; value < 256; value ++)
+  {
+    pattern = patterns[chunk] + value;
+
+    for (bit = 0; (bit < 8) && ((first + bit) < size); bit ++)
+    {
+      if ((value & (0x80 >> bit)) == 0)
+        continue;
+
+      position = positions[first + bit];
+
+      if (position < 64)
+        pattern->head |= 1ULL << (63 - position);
+      else
+        pattern->tail |= 0x80 >> (position - 64);
+    }
+  }
+}
+
+static void AddDeinterleaving(const uint8_t* positions, size_t size, size_t field)
+{
+  uint32_t* value;
+  int position;
+  int index;
+  int data;
+
+  for (index = 0; index < size; index ++)
+  {
+    position = positions[index];
+
+    for (data = 0; data < 256; data ++)
+      if (data & (0x80 >> (position % 8)))
+      {
+        value  = &fields[position / 8][data].a + field;
+        *value |= 1 << (size - 1 - index);
+      }
+  }
+}
+
+static void InitializeTables()
+{
+  uint32_t pattern;
+  uint32_t syndrome;
+  uint32_t value;
+  int index;
+  int bit1;
+  int bit2;
+  int bit3;
+
+  // Golay(23,12) encoder, the code is perfect, so patterns of up to three errors cover all syndromes
+
+  for (index = 0; index < GOLAY_DATA_SIZE; index ++)
+    encodings[index] = CalculateGolayCodeword(index);
+
+  for (bit1 = -1; bit1 < 23; bit1 ++)
+    for (bit2 = bit1; bit2 < 23; bit2 ++)
+      for (bit3 = bit2; bit3 < 23; bit3 ++)
+      {
+        if (((bit1 >= 0) && (bit1 == bit2)) ||
+            ((bit2 >= 0) && (bit2 == bit3)))
+          continue;
+
+        pattern =
+          ((bit1 >= 0) ? (1 << bit1) : 0) |
+          ((bit2 >= 0) ? (1 << bit2) : 0) |
+          ((bit3 >= 0) ? (1 << bit3) : 0);
+
+        syndrome = (encodings[pattern >> 11] ^ pattern) & (GOLAY_SYNDROMES - 1);
+        corrections[syndrome] = pattern;
+      }
+
+  // Pseudo-random sequence seeded by data of A
+
+  for (index = 0; index < GOLAY_DATA_SIZE; index ++)
+  {
+    value = 16 * index;
+    masks[index] = 0;
+
+    for (bit1 = 22; bit1 >= 0; bit1 --)
+    {
+      value = (173 * value + 13849) & 0xffff;
+      masks[index] |= (value >> 15) << bit1;
+    }
+  }
+
+  // Interleaving by byte of every field and deinterleaving by byte of frame
+
+  AddInterleaving(0, positionsA, FIELD_A_SIZE, 0);
+  AddInterleaving(1, positionsA, FIELD_A_SIZE, 8);
+  AddInterleaving(2, positionsA, FIELD_A_SIZE, 16);
+  AddInterleaving(3, positionsB, FIELD_B_SIZE, 0);
+  AddInterleaving(4, positionsB, FIELD_B_SIZE, 8);
+  AddInterleaving(5, positionsB, FIELD_B_SIZE, 16);
+  AddInterleaving(6, positionsC, FIELD_C_SIZE, 0);
+  AddInterleaving(7, positionsC, FIELD_C_SIZE, 8);
+  AddInterleaving(8, positionsC, FIELD_C_SIZE, 16);
+  AddInterleaving(9, positionsC, FIELD_C_SIZE, 24);
+
+  AddDeinterleaving(positionsA, FIELD_A_SIZE, 0);
+  AddDeinterleaving(positionsB, FIELD_B_SIZE, 1);
+  AddDeinterleaving(positionsC, FIELD_C_SIZE, 2);
+}
+
+static inline uint32_t CorrectGolayCodeword(uint32_t value, int* count)
+{
+  uint32_t pattern = corrections[(encodings[value >> 11] ^ value) & (GOLAY_SYNDROMES - 1)];
+  *count += __builtin_popcount(pattern);
+  return (value ^ pattern) >> 11;
+}
+
+static inline void EncodeFrame(uint8_t* frame, const uint8_t* linear)
+{
+  struct AMBEPattern value;
+  uint64_t data;
+  uint32_t a;
+  uint32_t b;
+  uint32_t c;
+  uint32_t parity;
+
+  // Linear frame is A (12), B (12) and C (25) data bits, most significant bit first
+
+  data =
+    ((uint64_t)linear[0] << 41) | ((uint64_t)linear[1] << 33) |
+    ((uint64_t)linear[2] << 25) | ((uint64_t)linear[3] << 17) |
+    ((uint64_t)linear[4] <<  9) | ((uint64_t)linear[5] <<  1) |
+    ((uint64_t)linear[6] >>  7);
+
+  a = (data >> 37) & 0xfff;
+  b = (data >> 25) & 0xfff;
+  c = (data << 7) & 0xffffff80;
+
+  parity = __builtin_parity(encodings[a]);
+  a = (encodings[a] << 1 | parity) << 8;
+  b = (encodings[b] ^ masks[a >> 20]) << 9;
+
+  value.head =
+    patterns[0][a >> 24].head | patterns[1][(a >> 16) & 0xff].head | patterns[2][(a >> 8) & 0xff].head |
+    patterns[3][b >> 24].head | patterns[4][(b >> 16) & 0xff].head | patterns[5][(b >> 8) & 0xff].head |
+    patterns[6][c >> 24].head | patterns[7][(c >> 16) & 0xff].head | patterns[8][(c >> 8) & 0xff].head |
+    patterns[9][c & 0xff].head;
+
+  value.tail =
+    patterns[0][a >> 24].tail | patterns[1][(a >> 16) & 0xff].tail | patterns[2][(a >> 8) & 0xff].tail |
+    patterns[3][b >> 24].tail | patterns[4][(b >> 16) & 0xff].tail | patterns[5][(b >> 8) & 0xff].tail |
+    patterns[6][c >> 24].tail | patterns[7][(c >> 16) & 0xff].tail | patterns[8][(c >> 8) & 0xff].tail |
+    patterns[9][c & 0xff].tail;
+
+  value.head = htobe64(value.head);
+  memcpy(frame, &value.head, sizeof(uint64_t));
+  frame[8] = value.tail;
+}
+
+static inline int DecodeFrame(uint8_t* linear, const uint8_t* frame)
+{
+  uint64_t data;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  uint32_t c = 0;
+  int count = 0;
+  int index;
+
+  for (index = 0; index < MODE33_FRAME_SIZE; index ++)
+  {
+    a |= fields[index][frame[index]].a;
+    b |= fields[index][frame[index]].b;
+    c |= fields[index][frame[index]].c;
+  }
+
+  // Parity bit of A is not used, Golay(23,12) part alone corrects up to three errors
+
+  a = CorrectGolayCodeword(a >> 1, &count);
+  b = CorrectGolayCodeword(b ^ masks[a], &count);
+
+  data = ((uint64_t)a << 37) | ((uint64_t)b << 25) | c;
+  data = htobe64(data << 15);
+  memcpy(linear, &data, LINEAR_FRAME_SIZE);
+
+  return count;
+}
+
+void EncodeAMBEMode33(uint8_t* frame, const uint8_t* linear)
+{
+  pthread_once(&initialization, InitializeTables);
+  EncodeFrame(frame, linear);
+}
+
+int DecodeAMBEMode33(uint8_t* linear, const uint8_t* frame)
+{
+  pthread_once(&initialization, InitializeTables);
+  return DecodeFrame(linear, frame);
+}
+
+size_t TranscodeAMBEFrames(uint8_t* destination, size_t size2, const uint8_t* source, size_t size1, size_t count)
+{
+  uint8_t linear[LINEAR_FRAME_SIZE + 1];
+  const uint8_t* frame;
+  size_t errors = 0;
+  int value;
+
+  pthread_once(&initialization, InitializeTables);
+
+  for ( ; count > 0; count --, source += size1, destination += size2)
+  {
+    // Bring every frame to linear format first
+
+    frame = source;
+    value = 0;
+
+    switch (size1)
+    {
+      case DSD_AMBE_CHUNK_SIZE:
+        // DSD keeps the 49th bit in the LSB of the last byte
+        memcpy(linear, source + 1, LINEAR_FRAME_SIZE - 1);
+        linear[LINEAR_FRAME_SIZE - 1] = source[LINEAR_FRAME_SIZE] << 7;
+        frame = linear;
+        break;
+
+      case MODE33_FRAME_SIZE:
+        if (size2 == MODE33_FRAME_SIZE)
+          break;
+        value   = DecodeFrame(linear, source);
+        errors += value;
+        frame   = linear;
+        break;
+    }
+
+    switch (size2)
+    {
+      case DSD_AMBE_CHUNK_SIZE:
+        destination[0] = (value < 255) ? value : 255;
+        memcpy(destination + 1, frame, LINEAR_FRAME_SIZE - 1);
+        destination[LINEAR_FRAME_SIZE] = frame[LINEAR_FRAME_SIZE - 1] >> 7;
+        break;
+
+      case LINEAR_FRAME_SIZE:
+        memcpy(destination, frame, LINEAR_FRAME_SIZE);
+        break;
+
+      case MODE33_FRAME_SIZE:
+        if (size1 == MODE33_FRAME_SIZE)
+          memcpy(destination, source, MODE33_FRAME_SIZE);
+        else
+          EncodeFrame(destination, frame);
+        break;
+    }
+  }
+
+  return errors;
+}
@@ -0,0 +1,64 @@
+#ifndef AMBE_H
+#define AMBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Input.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define AMBE_FRAME_VOICE     0
+#define AMBE_FRAME_SILENCE   1
+#define AMBE_FRAME_ERASURE   2
+
+// AMBE+2 silence frame as 49-bit linear and 72-bit mode 33 (FEC-protected, interleaved)
+
+extern const uint8_t AMBESilenceLinear[LINEAR_FRAME_SIZE];
+extern const uint8_t AMBESilenceMode33[MODE33_FRAME_SIZE];
+
+// <size> selects the format: DSD_AMBE_CHUNK_SIZE, LINEAR_FRAME_SIZE or MODE33_FRAME_SIZE
+int ClassifyAMBEFrame(const uint8_t* frame, size_t size);
+
+// Silence runs longer than <limit> frames are cut down to <limit> frames, the filter
+// keeps its state between calls so runs spanning several reads are handled as one
+
+struct SilenceFilter
+{
+  size_t size;        // Frame size
+  size_t limit;       // Longest silence run kept, 0 to keep everything
+  size_t run;         // Length of the current silence run
+
+  uint64_t frames;    // Frames passed through the filter
+  uint64_t dropped;   // Silence frames removed
+  uint64_t runs;      // Silence runs shortened
+};
+
+void InitializeSilenceFilter(struct SilenceFilter* filter, size_t size, size_t limit);
+
+// Compacts <count> frames in place and returns the number of frames kept
+size_t FilterSilenceFrames(struct SilenceFilter* filter, uint8_t* data, size_t count);
+
+// Reads until <count> frames are kept or input ends, <filter> may be NULL
+size_t ReadFilteredFrames(struct InputStream* stream, struct SilenceFilter* filter, uint8_t* buffer, size_t count);
+
+// Mode 33 carries the 49-bit frame as Golay(24,12) A, scrambled Golay(23,12) B and
+// unprotected C fields, interleaved over 72 bits. Both directions are bit-exact and
+// table-driven, decoding corrects up to three bit errors per Golay word and returns
+// the number of corrected bits.
+
+void EncodeAMBEMode33(uint8_t* frame, const uint8_t* linear);
+int DecodeAMBEMode33(uint8_t* linear, const uint8_t* frame);
+
+// Converts <count> frames of <size1> format into <size2> format, buffers must not overlap,
+// returns the number of bit errors corrected while decoding
+size_t TranscodeAMBEFrames(uint8_t* destination, size_t size2, const uint8_t* source, size_t size1, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+#define _GNU_SOURCE
+
+#include "Benchmark.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include <sys/resource.h>
+
+#define NANOSECONDS_PER_SECOND  1000000000ULL
+
+uint64_t GetBenchmarkTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+uint64_t GetBenchmarkProcessorTime(int who)
+{
+  struct rusage usage;
+  getrusage(who, &usage);
+  return
+    ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NANOSECONDS_PER_SECOND +
+    ((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000;
+}
+
+void RecordBenchmark(const char* name, double value)
+{
+  const char* path;
+  FILE* file;
+
+  if (((path = getenv(BENCHMARK_RESULTS_VARIABLE)) == NULL) ||
+      ((file = fopen(path, "a")) == NULL))
+    return;
+
+  fprintf(file, "%s/%s\t%.3f\t%.0f\n",
+    program_invocation_short_name,
+    name,
+    value,
+    (value > 0.0) ? (NANOSECONDS_PER_SECOND / value) : 0.0);
+
+  fclose(file);
+}
+
+void ReportBenchmark(const char* name, const char* unit, uint64_t duration, uint64_t count)
+{
+  double value = (double)duration / count;
+
+  printf("%-28s %10.2f ns/%-8s %14.0f %ss/s\n", name, value, unit, NANOSECONDS_PER_SECOND / value, unit);
+  RecordBenchmark(name, value);
+}
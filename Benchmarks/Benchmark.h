@@ -0,0 +1,32 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define BENCHMARK_RESULTS_VARIABLE  "BENCHMARK_RESULTS"
+
+// Shared harness of all benchmarks. Every result is printed for humans and, when
+// BENCHMARK_RESULTS names a file, appended to it as one tab-separated line:
+// <program>/<name>, nanoseconds per operation, operations per second.
+// Lower is better for every recorded value, see CompareResults.sh.
+
+uint64_t GetBenchmarkTime();
+uint64_t GetBenchmarkProcessorTime(int who);
+
+// Records a result without printing it, for benchmarks with their own report lines
+void RecordBenchmark(const char* name, double value);
+
+// Prints and records <count> operations of <unit> done in <duration> nanoseconds
+void ReportBenchmark(const char* name, const char* unit, uint64_t duration, uint64_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
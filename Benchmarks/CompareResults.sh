@@ -0,0 +1,57 @@
+#!/bin/sh
+
+# Compares results of make bench with a baseline, both written through BENCHMARK_RESULTS,
+# and fails when any of them takes more than <threshold> percent longer than before.
+# Files may hold several runs, the fastest one of each benchmark is compared.
+
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 <baseline> <results> [threshold in percent, default 10]"
+  exit 1
+fi
+
+BASELINE=$1
+RESULTS=$2
+THRESHOLD=${3:-10}
+
+if [ ! -f "$BASELINE" ]; then
+  echo "No baseline in $BASELINE, run make bench-baseline first"
+  exit 1
+fi
+
+awk -F '\t' -v threshold="$THRESHOLD" '
+  FNR == NR {
+    if (!($1 in baseline) || ($2 < baseline[$1]))
+      baseline[$1] = $2
+    next
+  }
+  {
+    if (!($1 in results)) {
+      names[count ++] = $1
+      results[$1] = $2
+    }
+    else if ($2 < results[$1])
+      results[$1] = $2
+  }
+  END {
+    for (item = 0; item < count; item ++) {
+      name = names[item]
+      if (!(name in baseline)) {
+        printf "%-52s %12s %12.2f %9s  new\n", name, "-", results[name], "-"
+        continue
+      }
+      change = (baseline[name] > 0) ? ((results[name] - baseline[name]) * 100 / baseline[name]) : 0
+      status = ""
+      if (change > threshold) {
+        status = "REGRESSION"
+        regressions ++
+      }
+      else if (change < -threshold)
+        status = "improvement"
+      printf "%-52s %12.2f %12.2f %+8.1f%%  %s\n", name, baseline[name], results[name], change, status
+    }
+    for (name in baseline)
+      if (!(name in results))
+        printf "%-52s %12.2f %12s %9s  missing\n", name, baseline[name], "-", "-"
+    printf "%d regressions beyond %s%% (ns/op, lower is better)\n", regressions, threshold
+    exit (regressions > 0)
+  }' "$BASELINE" "$RESULTS"
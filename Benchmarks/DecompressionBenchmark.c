@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <sys/resource.h>
+
+#include "Input.h"
+#include "Benchmark.h"
+
+#define FRAME_COUNT    90000
+#define SILENCE_RATIO  5
+#define REPEAT_COUNT   10
+
+static const uint8_t silence[DSD_AMBE_CHUNK_SIZE] = { 0x00, 0xf8, 0x01, 0xa9, 0x9f, 0x8c, 0xe0, 0x01 };
+
+static size_t ReadAllFrames(int handle)
+{
+  struct InputStream stream;
+  uint8_t buffer[3 * DSD_AMBE_CHUNK_SIZE];
+  size_t count = 0;
+
+  if (OpenInputStream(&stream, handle, DSD_AMBE_CHUNK_SIZE) != INPUT_ERROR_SUCCESS)
+    return 0;
+
+  while (ReadInputFrames(&stream, buffer, 3) == 3)
+    count += 3;
+
+  CloseInputStream(&stream);
+  return count;
+}
+
+static void Report(const char* name, uint64_t duration, uint64_t processor, size_t count)
+{
+  printf("%-24s %8.2f ns/frame wall %8.2f ns/frame CPU %8.2f ms CPU per 30 min stream\n",
+    name,
+    (double)duration / count,
+    (double)processor / count,
+    (double)processor / count * FRAME_COUNT / 1000000);
+
+  // Wall time of the pipe hides the work of zcat, CPU time is what both cost
+  RecordBenchmark(name, (double)processor / count);
+}
+
+int main(int argc, char* argv[])
+{
+  char name[] = "/tmp/DecompressionBenchmark.XXXXXX";
+  char command[64];
+  uint8_t frame[DSD_AMBE_CHUNK_SIZE];
+  uint32_t state = 1;
+  size_t index;
+  size_t count;
+  size_t total;
+  uint64_t start;
+  uint64_t processor;
+  gzFile file;
+  FILE* pipe;
+  int handle;
+
+  // Generate a 30 minute DSD bulletin with some silence and compress it
+
+  handle = mkstemp(name);
+  file = gzdopen(handle, "wb");
+
+  if (file == NULL)
+  {
+    printf("Error creating temporary file\n");
+    return EXIT_FAILURE;
+  }
+
+  gzwrite(file, DSD_MAGIC_TEXT, DSD_MAGIC_SIZE);
+
+  for (index = 0; index < FRAME_COUNT; index ++)
+  {
+    if ((index % SILENCE_RATIO) == 0)
+    {
+      gzwrite(file, silence, DSD_AMBE_CHUNK_SIZE);
+      continue;
+    }
+
+    frame[0] = 0;
+    for (count = 1; count < DSD_AMBE_CHUNK_SIZE; count ++)
+    {
+      state = state * 1103515245 + 12345;
+      frame[count] = state >> 24;
+    }
+    frame[DSD_AMBE_CHUNK_SIZE - 1] &= 1;
+    gzwrite(file, frame, DSD_AMBE_CHUNK_SIZE);
+  }
+
+  gzclose(file);
+
+  // Native streaming decompression
+
+  total     = 0;
+  start     = GetBenchmarkTime();
+  processor = GetBenchmarkProcessorTime(RUSAGE_SELF);
+
+  for (index = 0; index < REPEAT_COUNT; index ++)
+  {
+    handle = open(name, O_RDONLY);
+    total += ReadAllFrames(handle);
+    close(handle);
+  }
+
+  Report("native gzip", GetBenchmarkTime() - start, GetBenchmarkProcessorTime(RUSAGE_SELF) - processor, total);
+
+  // zcat piped into the reader
+
+  snprintf(command, sizeof(command), "zcat %s", name);
+
+  total     = 0;
+  start     = GetBenchmarkTime();
+  processor = GetBenchmarkProcessorTime(RUSAGE_SELF) + GetBenchmarkProcessorTime(RUSAGE_CHILDREN);
+
+  for (index = 0; index < REPEAT_COUNT; index ++)
+  {
+    pipe = popen(command, "r");
+    total += ReadAllFrames(fileno(pipe));
+    pclose(pipe);
+  }
+
+  Report("zcat pipe", GetBenchmarkTime() - start, GetBenchmarkProcessorTime(RUSAGE_SELF) + GetBenchmarkProcessorTime(RUSAGE_CHILDREN) - processor, total);
+
+  unlink(name);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "RewindClient.h"
+#include "Benchmark.h"
+
+#ifndef USE_OPENSSL
+#include "sha256.h"
+
+// Not declared by sha256.h, the block function behind every update
+void sha256_transform(SHA256_CTX* context, const BYTE data[]);
+#endif
+
+#define BLOCK_COUNT    2000000
+#define LOGIN_COUNT    1000000
+#define CHALLENGE_SIZE 4
+#define BUFFER_SIZE    256
+
+int main(int argc, char* argv[])
+{
+  uint64_t storage[BUFFER_SIZE / sizeof(uint64_t)];
+  struct RewindData* buffer = (struct RewindData*)storage;
+  uint8_t digest[REWIND_DIGEST_SIZE];
+  volatile uint8_t sink = 0;
+  uint64_t start;
+  size_t index;
+
+#ifndef USE_OPENSSL
+  SHA256_CTX context;
+  uint8_t block[64];
+
+  memset(block, 0x5a, sizeof(block));
+  sha256_init(&context);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < BLOCK_COUNT; index ++)
+    sha256_transform(&context, block);
+  ReportBenchmark("sha256_transform", "block", GetBenchmarkTime() - start, BLOCK_COUNT);
+
+  sink ^= context.state[0];
+#endif
+
+  // Login answer: challenge from the server with the password appended, hashed as one message
+
+  memset(buffer, 0, sizeof(struct RewindData) + CHALLENGE_SIZE);
+  memcpy(buffer->sign, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < LOGIN_COUNT; index ++)
+  {
+    *(uint32_t*)buffer->data = index;
+    DigestRewindChallenge(digest, buffer, sizeof(struct RewindData) + CHALLENGE_SIZE, "passw0rd");
+    sink ^= digest[0];
+  }
+  ReportBenchmark("challenge digest", "login", GetBenchmarkTime() - start, LOGIN_COUNT);
+
+  (void)sink;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "Input.h"
+#include "Benchmark.h"
+
+#define FRAME_COUNT    90000
+#define SILENCE_RATIO  5
+#define REPEAT_COUNT   3
+
+static const uint8_t silence[DSD_AMBE_CHUNK_SIZE] = { 0x00, 0xf8, 0x01, 0xa9, 0x9f, 0x8c, 0xe0, 0x01 };
+
+// Full playout by the command line tool on virtual time against its local stand-in server,
+// the tool fails when the stand-in finds gaps, misordered packets or late keep-alives
+
+static int RunPlayout(const char* program, const char* name, char* const* arguments)
+{
+  int status = -1;
+  int handle;
+  pid_t identifier;
+
+  identifier = fork();
+
+  if (identifier == 0)
+  {
+    handle = open(name, O_RDONLY);
+    dup2(handle, STDIN_FILENO);
+    close(handle);
+
+    handle = open("/dev/null", O_WRONLY);
+    dup2(handle, STDOUT_FILENO);
+    dup2(handle, STDERR_FILENO);
+    close(handle);
+
+    execv(program, arguments);
+    _exit(EXIT_FAILURE);
+  }
+
+  if ((identifier < 0) ||
+      (waitpid(identifier, &status, 0) < 0))
+    return -1;
+
+  return (WIFEXITED(status) && (WEXITSTATUS(status) == EXIT_SUCCESS)) ? 0 : -1;
+}
+
+static int MeasurePlayout(const char* program, const char* name, const char* title, char* const* arguments)
+{
+  uint64_t start;
+  uint64_t processor;
+  uint64_t duration;
+  size_t index;
+
+  start     = GetBenchmarkTime();
+  processor = GetBenchmarkProcessorTime(RUSAGE_CHILDREN);
+
+  for (index = 0; index < REPEAT_COUNT; index ++)
+    if (RunPlayout(program, name, arguments) < 0)
+    {
+      printf("%s: playout failed\n", title);
+      return -1;
+    }
+
+  duration  = GetBenchmarkTime() - start;
+  processor = GetBenchmarkProcessorTime(RUSAGE_CHILDREN) - processor;
+
+  printf("%-28s %8.2f ns/frame wall %8.2f ns/frame CPU %8.2f ms CPU per 30 min stream\n",
+    title,
+    (double)duration / (REPEAT_COUNT * FRAME_COUNT),
+    (double)processor / (REPEAT_COUNT * FRAME_COUNT),
+    (double)processor / REPEAT_COUNT / 1000000);
+
+  RecordBenchmark(title, (double)processor / (REPEAT_COUNT * FRAME_COUNT));
+  return 0;
+}
+
+int main(int argc, char* argv[])
+{
+  char name[] = "/tmp/PlayoutBenchmark.XXXXXX";
+  const char* program = (argc > 1) ? argv[1] : "./digestplay";
+  char* linear[] = { "digestplay", "-c", "1", "-u", "1", "-g", "9", "--simulate", NULL };
+  char* mode33[] = { "digestplay", "-c", "1", "-u", "1", "-g", "9", "--simulate", "--transmit", "mode33", NULL };
+  uint8_t frame[DSD_AMBE_CHUNK_SIZE];
+  uint32_t state = 1;
+  size_t index;
+  size_t count;
+  FILE* file;
+  int result;
+
+  if (access(program, X_OK) != 0)
+  {
+    printf("Playout benchmark needs %s, build it first\n", program);
+    return EXIT_FAILURE;
+  }
+
+  // Generate a 30 minute DSD bulletin with some silence
+
+  file = fdopen(mkstemp(name), "wb");
+
+  if (file == NULL)
+  {
+    printf("Error creating temporary file\n");
+    return EXIT_FAILURE;
+  }
+
+  fwrite(DSD_MAGIC_TEXT, 1, DSD_MAGIC_SIZE, file);
+
+  for (index = 0; index < FRAME_COUNT; index ++)
+  {
+    if ((index % SILENCE_RATIO) == 0)
+    {
+      fwrite(silence, 1, DSD_AMBE_CHUNK_SIZE, file);
+      continue;
+    }
+
+    frame[0] = 0;
+    for (count = 1; count < DSD_AMBE_CHUNK_SIZE; count ++)
+    {
+      state = state * 1103515245 + 12345;
+      frame[count] = state >> 24;
+    }
+    frame[DSD_AMBE_CHUNK_SIZE - 1] &= 1;
+    fwrite(frame, 1, DSD_AMBE_CHUNK_SIZE, file);
+  }
+
+  fclose(file);
+
+  result =
+    (MeasurePlayout(program, name, "playout DSD > linear", linear) < 0) ||
+    (MeasurePlayout(program, name, "playout DSD > mode33", mode33) < 0);
+
+  unlink(name);
+  return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
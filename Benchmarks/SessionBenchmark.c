@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <malloc.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "RewindClient.h"
+#include "SessionTable.h"
+#include "Benchmark.h"
+
+#define SESSION_COUNT  10000
+#define TICK_COUNT     400
+
+static size_t GetHeapUsage()
+{
+  struct mallinfo2 information = mallinfo2();
+  return information.uordblks + information.hblkhd;
+}
+
+static void Report(const char* name, uint64_t duration, uint64_t count, size_t memory, size_t scanned)
+{
+  printf("%-24s %8zu bytes/session %12.0f ns/tick %10.1f sessions visited/tick\n",
+    name,
+    memory / SESSION_COUNT,
+    (double)duration / count,
+    (double)scanned / count);
+  RecordBenchmark(name, (double)duration / count);
+}
+
+// Separate contexts: one scan over all of them per tick to find due keep-alives
+
+static void MeasureContexts(const char* port, uint64_t base)
+{
+  struct RewindContext** contexts;
+  uint64_t interval = REWIND_KEEP_ALIVE_INTERVAL * NANOSECONDS_PER_SECOND;
+  uint64_t now;
+  uint64_t start;
+  uint64_t duration;
+  size_t memory;
+  size_t scanned;
+  size_t index;
+  size_t tick;
+
+  contexts = (struct RewindContext**)calloc(SESSION_COUNT, sizeof(struct RewindContext*));
+  memory   = GetHeapUsage();
+
+  for (index = 0; index < SESSION_COUNT; index ++)
+  {
+    contexts[index] = CreateRewindContext(index + 1, "Benchmark");
+    ResolveRewindAddress(contexts[index], "::1", port);
+    contexts[index]->probes[REWIND_PROBE_KEEP_ALIVE].time = base;
+  }
+
+  memory = GetHeapUsage() - memory;
+
+  // Idle ticks: nothing is due, every context is still visited
+
+  scanned = 0;
+  start   = GetBenchmarkTime();
+
+  for (tick = 1; tick <= TICK_COUNT; tick ++)
+  {
+    now = base + (tick % (interval / SESSION_WHEEL_RESOLUTION)) * SESSION_WHEEL_RESOLUTION;
+
+    for (index = 0; index < SESSION_COUNT; index ++)
+    {
+      scanned ++;
+      if ((contexts[index]->probes[REWIND_PROBE_KEEP_ALIVE].time + interval) <= now)
+        TransmitRewindKeepAlive(contexts[index]);
+    }
+  }
+
+  duration = GetBenchmarkTime() - start;
+  Report("idle tick (contexts)", duration, TICK_COUNT, memory, scanned);
+
+  // Keep-alive ticks: deadlines are spread over the interval, as sessions open at random times
+
+  for (index = 0; index < SESSION_COUNT; index ++)
+    contexts[index]->probes[REWIND_PROBE_KEEP_ALIVE].time = base - interval + index * (interval / SESSION_COUNT);
+
+  scanned = 0;
+  start   = GetBenchmarkTime();
+
+  for (tick = 1; tick <= TICK_COUNT; tick ++)
+  {
+    now = base + tick * SESSION_WHEEL_RESOLUTION;
+
+    for (index = 0; index < SESSION_COUNT; index ++)
+    {
+      scanned ++;
+      if ((contexts[index]->probes[REWIND_PROBE_KEEP_ALIVE].time + interval) <= now)
+      {
+        TransmitRewindKeepAlive(contexts[index]);
+        contexts[index]->probes[REWIND_PROBE_KEEP_ALIVE].time = now;
+      }
+    }
+  }
+
+  duration = GetBenchmarkTime() - start;
+  Report("busy tick (contexts)", duration, TICK_COUNT, memory, scanned);
+
+  for (index = 0; index < SESSION_COUNT; index ++)
+    ReleaseRewindContext(contexts[index]);
+
+  free(contexts);
+}
+
+// Session table: the wheel visits only the slot that is due
+
+static void MeasureTable(const char* port, uint64_t base, int spread)
+{
+  struct SessionTable* table;
+  uint64_t interval = REWIND_KEEP_ALIVE_INTERVAL * NANOSECONDS_PER_SECOND;
+  uint64_t start;
+  uint64_t duration;
+  size_t memory;
+  size_t scanned;
+  size_t count;
+  size_t index;
+  size_t tick;
+  int address;
+
+  memory  = GetHeapUsage();
+  table   = CreateSessionTable(SESSION_COUNT, "Benchmark", "password");
+  address = ResolveSessionAddress(table, "::1", port);
+
+  // Spread sessions fall due one by one from base on, the others all at once one interval later
+
+  for (index = 0; index < SESSION_COUNT; index ++)
+    OpenSession(table, index + 1, address, spread ? (base - interval + index * (interval / SESSION_COUNT)) : base);
+
+  memory = GetHeapUsage() - memory;
+
+  AdvanceSessionTable(table, spread ? (base - SESSION_WHEEL_RESOLUTION) : base);
+
+  // Idle run stops short of the first deadline
+
+  count   = spread ? TICK_COUNT : (table->interval - 1);
+  scanned = table->statistics.scanned;
+  start   = GetBenchmarkTime();
+
+  for (tick = 1; tick <= count; tick ++)
+    AdvanceSessionTable(table, base + tick * SESSION_WHEEL_RESOLUTION);
+
+  duration = GetBenchmarkTime() - start;
+  scanned  = table->statistics.scanned - scanned;
+  Report(spread ? "busy tick (table)" : "idle tick (table)", duration, count, memory, scanned);
+
+  ReleaseSessionTable(table);
+}
+
+int main(int argc, char* argv[])
+{
+  struct RewindContext* sink;
+  struct sockaddr_in6 address;
+  socklen_t size = sizeof(struct sockaddr_in6);
+  struct rlimit limit;
+  uint64_t base;
+  char port[8];
+
+  // One socket per session either way
+
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+
+  if (limit.rlim_cur < (SESSION_COUNT + 64))
+  {
+    printf("Session benchmark needs %u descriptors, only %lu are allowed\n", SESSION_COUNT + 64, (unsigned long)limit.rlim_cur);
+    return EXIT_SUCCESS;
+  }
+
+  // Keep-alives go to a context on loopback that never reads them
+
+  sink = CreateRewindContext(0, "Sink");
+  getsockname(sink->handle, (struct sockaddr*)&address, &size);
+  sprintf(port, "%u", ntohs(address.sin6_port));
+
+  base = GetBenchmarkTime();
+
+  printf("%u sessions, keep-alive every %u s, wheel of %u slots by %llu ms\n",
+    SESSION_COUNT,
+    REWIND_KEEP_ALIVE_INTERVAL,
+    SESSION_WHEEL_LENGTH,
+    SESSION_WHEEL_RESOLUTION / NANOSECONDS_PER_MILLISECOND);
+
+  MeasureContexts(port, base);
+  MeasureTable(port, base, 0);
+  MeasureTable(port, base, 1);
+
+  ReleaseRewindContext(sink);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "AMBE.h"
+#include "Benchmark.h"
+
+#define FRAME_COUNT    4096
+#define ITERATIONS     500
+
+#define FRAMES_PER_SECOND  50
+
+#define NANOSECONDS_PER_SECOND  1000000000ULL
+
+// Field bits in order of their positions in mode 33 frame
+
+static const uint8_t positions[3][25] =
+{
+  {  0,  4,  8, 12, 16, 20, 24, 28, 32, 36, 40, 44, 48, 52, 56, 60, 64, 68,  1,  5,  9, 13, 17, 21 },
+  { 25, 29, 33, 37, 41, 45, 49, 53, 57, 61, 65, 69,  2,  6, 10, 14, 18, 22, 26, 30, 34, 38, 42 },
+  { 46, 50, 54, 58, 62, 66, 70,  3,  7, 11, 15, 19, 23, 27, 31, 35, 39, 43, 47, 51, 55, 59, 63, 67, 71 }
+};
+
+// Bit by bit encoder as found in common AMBE tools, used as a reference
+
+static uint32_t EncodeGolay(uint32_t data)
+{
+  uint32_t value = data << 11;
+  int index;
+
+  for (index = 22; index >= 11; index --)
+    if (value & (1 << index))
+      value ^= 0xc75 << (index - 11);
+
+  return (data << 11) | value;
+}
+
+static void EncodeReference(uint8_t* frame, const uint8_t* linear)
+{
+  uint32_t words[3];
+  uint32_t value;
+  int sizes[3] = { 24, 23, 25 };
+  int index;
+  int field;
+  int bit;
+
+  words[0] = 0;
+  words[1] = 0;
+  words[2] = 0;
+
+  for (index = 0; index < 49; index ++)
+  {
+    bit = (linear[index / 8] >> (7 - index % 8)) & 1;
+    field = (index < 12) ? 0 : (index < 24) ? 1 : 2;
+    words[field] = (words[field] << 1) | bit;
+  }
+
+  words[0] = EncodeGolay(words[0]);
+  words[0] = (words[0] << 1) | __builtin_parity(words[0]);
+  words[1] = EncodeGolay(words[1]);
+
+  value = 16 * (words[0] >> 12);
+  for (index = 22; index >= 0; index --)
+  {
+    value = (173 * value + 13849) & 0xffff;
+    words[1] ^= (value >> 15) << index;
+  }
+
+  memset(frame, 0, MODE33_FRAME_SIZE);
+
+  for (field = 0; field < 3; field ++)
+    for (index = 0; index < sizes[field]; index ++)
+    {
+      bit = (words[field] >> (sizes[field] - 1 - index)) & 1;
+      frame[positions[field][index] / 8] |= bit << (7 - positions[field][index] % 8);
+    }
+}
+
+static void Report(const char* name, uint64_t duration, uint64_t count)
+{
+  double value = (double)duration / count;
+  printf("%-28s %8.2f ns/frame %12.0f frames/s %10.0f streams\n", name, value, NANOSECONDS_PER_SECOND / value, NANOSECONDS_PER_SECOND / value / FRAMES_PER_SECOND);
+  RecordBenchmark(name, value);
+}
+
+int main(int argc, char* argv[])
+{
+  uint8_t* linear = (uint8_t*)malloc(FRAME_COUNT * LINEAR_FRAME_SIZE);
+  uint8_t* mode33 = (uint8_t*)malloc(FRAME_COUNT * MODE33_FRAME_SIZE);
+  uint8_t* dsd    = (uint8_t*)malloc(FRAME_COUNT * DSD_AMBE_CHUNK_SIZE);
+  uint8_t* check  = (uint8_t*)malloc(FRAME_COUNT * MODE33_FRAME_SIZE);
+  volatile size_t errors = 0;
+  uint64_t start;
+  size_t index;
+
+  srand(1);
+
+  for (index = 0; index < FRAME_COUNT * LINEAR_FRAME_SIZE; index ++)
+    linear[index] = rand();
+  for (index = 0; index < FRAME_COUNT; index ++)
+    linear[index * LINEAR_FRAME_SIZE + LINEAR_FRAME_SIZE - 1] &= 0x80;
+
+  // Both encoders have to agree bit by bit before timing
+
+  TranscodeAMBEFrames(mode33, MODE33_FRAME_SIZE, linear, LINEAR_FRAME_SIZE, FRAME_COUNT);
+
+  for (index = 0; index < FRAME_COUNT; index ++)
+  {
+    EncodeReference(check + index * MODE33_FRAME_SIZE, linear + index * LINEAR_FRAME_SIZE);
+    if (memcmp(check + index * MODE33_FRAME_SIZE, mode33 + index * MODE33_FRAME_SIZE, MODE33_FRAME_SIZE) != 0)
+    {
+      printf("Encoders disagree on frame %zu\n", index);
+      return EXIT_FAILURE;
+    }
+  }
+
+  TranscodeAMBEFrames(check, LINEAR_FRAME_SIZE, mode33, MODE33_FRAME_SIZE, FRAME_COUNT);
+
+  if (memcmp(check, linear, FRAME_COUNT * LINEAR_FRAME_SIZE) != 0)
+  {
+    printf("Round trip does not restore linear frames\n");
+    return EXIT_FAILURE;
+  }
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    for (size_t frame = 0; frame < FRAME_COUNT; frame ++)
+      EncodeReference(check + frame * MODE33_FRAME_SIZE, linear + frame * LINEAR_FRAME_SIZE);
+  Report("linear > mode33 (bitwise)", GetBenchmarkTime() - start, ITERATIONS * FRAME_COUNT);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    TranscodeAMBEFrames(mode33, MODE33_FRAME_SIZE, linear, LINEAR_FRAME_SIZE, FRAME_COUNT);
+  Report("linear > mode33 (tables)", GetBenchmarkTime() - start, ITERATIONS * FRAME_COUNT);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    errors += TranscodeAMBEFrames(check, LINEAR_FRAME_SIZE, mode33, MODE33_FRAME_SIZE, FRAME_COUNT);
+  Report("mode33 > linear (tables)", GetBenchmarkTime() - start, ITERATIONS * FRAME_COUNT);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    errors += TranscodeAMBEFrames(dsd, DSD_AMBE_CHUNK_SIZE, mode33, MODE33_FRAME_SIZE, FRAME_COUNT);
+  Report("mode33 > DSD (tables)", GetBenchmarkTime() - start, ITERATIONS * FRAME_COUNT);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    TranscodeAMBEFrames(mode33, MODE33_FRAME_SIZE, dsd, DSD_AMBE_CHUNK_SIZE, FRAME_COUNT);
+  Report("DSD > mode33 (tables)", GetBenchmarkTime() - start, ITERATIONS * FRAME_COUNT);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    TranscodeAMBEFrames(check, LINEAR_FRAME_SIZE, dsd, DSD_AMBE_CHUNK_SIZE, FRAME_COUNT);
+  Report("DSD > linear", GetBenchmarkTime() - start, ITERATIONS * FRAME_COUNT);
+
+  free(linear);
+  free(mode33);
+  free(dsd);
+  free(check);
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <endian.h>
+
+#include "RewindClient.h"
+#include "Benchmark.h"
+
+#define ITERATIONS     10000000
+#define SEND_COUNT     200000
+#define BATCH_SIZE     64
+#define BUFFER_SIZE    512
+
+// Header construction as done by TransmitRewindData before packet templates
+
+static struct msghdr* BuildLegacyData(struct RewindContext* context, struct msghdr* message, struct iovec* vectors, struct RewindData* header, uint16_t type, uint16_t flag, void* data, size_t length)
+{
+  size_t index;
+  uint32_t number;
+
+  memset(header, 0, sizeof(struct RewindData));
+  memcpy(header, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH);
+
+  index = flag & REWIND_FLAG_REAL_TIME_1;
+  number = context->counters[index];
+
+  header->type   = htole16(type);
+  header->flags  = htole16(flag);
+  header->number = htole32(number);
+  header->length = htole16(length);
+
+  vectors[0].iov_base     = header;
+  vectors[0].iov_len      = sizeof(struct RewindData);
+  vectors[1].iov_base     = data;
+  vectors[1].iov_len      = length;
+  message->msg_name       = context->address->ai_addr;
+  message->msg_namelen    = context->address->ai_addrlen;
+  message->msg_iov        = vectors;
+  message->msg_iovlen     = 2;
+  message->msg_control    = NULL;
+  message->msg_controllen = 0;
+  message->msg_flags      = 0;
+
+  context->counters[index] ++;
+
+  return message;
+}
+
+int main(int argc, char* argv[])
+{
+  struct RewindContext* context;
+  struct addrinfo hints;
+  struct sockaddr_in6 address;
+  socklen_t size = sizeof(struct sockaddr_in6);
+  char port[8];
+
+  struct msghdr message;
+  struct iovec vectors[2];
+  struct RewindData header;
+  uint8_t buffer[27];
+  uint8_t packet[BUFFER_SIZE];
+
+  volatile struct msghdr* sink;
+  uint64_t start;
+  uint64_t duration;
+  size_t received;
+  size_t index;
+  size_t count;
+
+  context = CreateRewindContext(0, "Benchmark");
+
+  if (context == NULL)
+  {
+    printf("Error creating context\n");
+    return EXIT_FAILURE;
+  }
+
+  // Use the own socket of the context as a packet sink on loopback
+
+  getsockname(context->handle, (struct sockaddr*)&address, &size);
+  sprintf(port, "%u", ntohs(address.sin6_port));
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_family   = AF_INET6;
+
+  if (getaddrinfo("::1", port, &hints, &context->address) != 0)
+  {
+    printf("Error resolving loopback address\n");
+    ReleaseRewindContext(context);
+    return EXIT_FAILURE;
+  }
+
+  context->message.msg_name    = context->address->ai_addr;
+  context->message.msg_namelen = context->address->ai_addrlen;
+
+  memset(buffer, 0, sizeof(buffer));
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    sink = BuildLegacyData(context, &message, vectors, &header, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, sizeof(buffer));
+  ReportBenchmark("header build (legacy)", "packet", GetBenchmarkTime() - start, ITERATIONS);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < ITERATIONS; index ++)
+    sink = PrepareRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, sizeof(buffer));
+  ReportBenchmark("header build (template)", "packet", GetBenchmarkTime() - start, ITERATIONS);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < SEND_COUNT; index ++)
+    sendmsg(context->handle, BuildLegacyData(context, &message, vectors, &header, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, sizeof(buffer)), MSG_DONTWAIT);
+  ReportBenchmark("transmit (legacy)", "packet", GetBenchmarkTime() - start, SEND_COUNT);
+
+  start = GetBenchmarkTime();
+  for (index = 0; index < SEND_COUNT; index ++)
+    TransmitRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, sizeof(buffer));
+  ReportBenchmark("transmit (template)", "packet", GetBenchmarkTime() - start, SEND_COUNT);
+
+  // Drain the loopback queue, then receive batches small enough for the socket buffer
+
+  while (FetchRewindData(context, (struct RewindData*)packet, BUFFER_SIZE) >= 0);
+
+  duration = 0;
+  received = 0;
+
+  for (index = 0; index < SEND_COUNT; index += BATCH_SIZE)
+  {
+    for (count = 0; count < BATCH_SIZE; count ++)
+      TransmitRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, sizeof(buffer));
+
+    start = GetBenchmarkTime();
+    for (count = 0; count < BATCH_SIZE; count ++)
+      received += ReceiveRewindData(context, (struct RewindData*)packet, BUFFER_SIZE) > 0;
+    duration += GetBenchmarkTime() - start;
+  }
+
+  ReportBenchmark("receive", "packet", duration, received);
+
+  (void)sink;
+
+  ReleaseRewindContext(context);
+  return EXIT_SUCCESS;
+}
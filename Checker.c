@@ -0,0 +1,455 @@
+#include "Checker.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Input.h"
+#include "AMBE.h"
+
+#define PACKET_FRAME_COUNT  3
+#define READ_CHUNK_SIZE     (64 * 1024)
+#define THREAD_FACTOR       4   // Most threads per online CPU, reads may block on I/O
+
+struct CheckList
+{
+  struct CheckResult* results;
+  size_t count;
+  size_t capacity;
+  size_t next;
+  size_t size;
+  size_t limit;
+};
+
+static size_t CountSilenceFrames(const uint8_t* data, size_t length, size_t size)
+{
+  size_t count = 0;
+  size_t offset;
+
+  for (offset = 0; (offset + size) <= length; offset += size)
+    count += (ClassifyAMBEFrame(data + offset, size) == AMBE_FRAME_SILENCE);
+
+  return count;
+}
+
+void CheckBuffer(struct CheckResult* result, const uint8_t* data, size_t length, size_t size)
+{
+  size_t run1 = 0;
+  size_t run2 = 0;
+  size_t offset;
+  size_t silence1;
+  size_t silence2;
+
+  // Detect format: DSD has a signature, raw formats are told apart by silence frames and size
+
+  if ((length >= DSD_MAGIC_SIZE) &&
+      (memcmp(data, DSD_MAGIC_TEXT, DSD_MAGIC_SIZE) == 0))
+  {
+    size    = DSD_AMBE_CHUNK_SIZE;
+    data   += DSD_MAGIC_SIZE;
+    length -= DSD_MAGIC_SIZE;
+  }
+
+  if ((size != DSD_AMBE_CHUNK_SIZE) &&
+      (size != LINEAR_FRAME_SIZE) &&
+      (size != MODE33_FRAME_SIZE))
+  {
+    silence1 = CountSilenceFrames(data, length, LINEAR_FRAME_SIZE);
+    silence2 = CountSilenceFrames(data, length, MODE33_FRAME_SIZE);
+
+    size = MODE33_FRAME_SIZE;
+
+    if ((silence1 > silence2) ||
+        (silence1 == silence2) &&
+        ((length % MODE33_FRAME_SIZE) != 0) &&
+        ((length % LINEAR_FRAME_SIZE) == 0))
+      size = LINEAR_FRAME_SIZE;
+  }
+
+  result->size      = size;
+  result->frames    = length / size;
+  result->partial   = length % size;
+  result->packets   = result->frames / PACKET_FRAME_COUNT;
+  result->remainder = result->frames % PACKET_FRAME_COUNT;
+
+  for (offset = 0; (offset + size) <= length; offset += size)
+  {
+    switch (ClassifyAMBEFrame(data + offset, size))
+    {
+      case AMBE_FRAME_SILENCE:
+        result->silence ++;
+        result->dropped += (result->limit > 0) && (run1 >= result->limit);
+        run1 ++;
+        run2 = 0;
+        break;
+
+      case AMBE_FRAME_ERASURE:
+        result->erasures ++;
+        run2 ++;
+        run1 = 0;
+        break;
+
+      default:
+        run1 = 0;
+        run2 = 0;
+        break;
+    }
+
+    result->runs += (run1 == CHECK_SILENCE_THRESHOLD);
+
+    if (result->longest < run1)
+      result->longest = run1;
+    if (result->burst < run2)
+      result->burst = run2;
+  }
+}
+
+void CheckFile(struct CheckResult* result, size_t size)
+{
+  struct InputStream stream;
+  struct stat status;
+  uint8_t magic[COMPRESSION_MAGIC_SIZE];
+  uint8_t* data;
+  uint8_t* buffer;
+  size_t length;
+  size_t count;
+  int handle;
+
+  handle = open(result->path, O_RDONLY);
+
+  if ((handle < 0) ||
+      (fstat(handle, &status) < 0))
+  {
+    result->error = CHECK_ERROR_OPEN;
+    close(handle);
+    return;
+  }
+
+  if (status.st_size == 0)
+  {
+    result->error = CHECK_ERROR_EMPTY;
+    close(handle);
+    return;
+  }
+
+  if ((pread(handle, magic, COMPRESSION_MAGIC_SIZE, 0) == COMPRESSION_MAGIC_SIZE) &&
+      (DetectCompression(magic, COMPRESSION_MAGIC_SIZE) == COMPRESSION_NONE))
+  {
+    // Plain file is scanned in place
+
+    data = (uint8_t*)mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+
+    if (data == MAP_FAILED)
+    {
+      result->error = CHECK_ERROR_OPEN;
+      close(handle);
+      return;
+    }
+
+    madvise(data, status.st_size, MADV_SEQUENTIAL);
+    CheckBuffer(result, data, status.st_size, size);
+    munmap(data, status.st_size);
+    close(handle);
+    return;
+  }
+
+  // Compressed file is inflated into memory, byte-sized frames keep the input stream from interpreting it
+
+  if (OpenInputStream(&stream, handle, 1) != INPUT_ERROR_SUCCESS)
+  {
+    result->error = CHECK_ERROR_COMPRESSION;
+    close(handle);
+    return;
+  }
+
+  data   = NULL;
+  length = 0;
+
+  do
+  {
+    buffer = (uint8_t*)realloc(data, length + READ_CHUNK_SIZE);
+    if (buffer == NULL)
+      break;
+    data    = buffer;
+    count   = ReadInputFrames(&stream, data + length, READ_CHUNK_SIZE);
+    length += count;
+  }
+  while (count == READ_CHUNK_SIZE);
+
+  if (CheckInputStream(&stream) < 0)
+    result->error = CHECK_ERROR_DATA;
+  else if (length == 0)
+    result->error = CHECK_ERROR_EMPTY;
+
+  CloseInputStream(&stream);
+  close(handle);
+
+  if (result->error == CHECK_ERROR_SUCCESS)
+    CheckBuffer(result, data, length, size);
+
+  free(data);
+}
+
+static void AppendCheckResult(struct CheckList* list, const char* path, int error)
+{
+  struct CheckResult* results;
+
+  if (list->count == list->capacity)
+  {
+    list->capacity = (list->capacity > 0) ? (list->capacity * 2) : 256;
+    results = (struct CheckResult*)realloc(list->results, list->capacity * sizeof(struct CheckResult));
+    if (results == NULL)
+      return;
+    list->results = results;
+  }
+
+  memset(list->results + list->count, 0, sizeof(struct CheckResult));
+  list->results[list->count].path  = strdup(path);
+  list->results[list->count].limit = list->limit;
+  list->results[list->count].error = error;
+  list->count ++;
+}
+
+static void AddCheckPath(struct CheckList* list, const char* path, int nested)
+{
+  struct dirent* entry;
+  struct stat status;
+  DIR* directory;
+  char* name;
+
+  // Paths given by the user may be symbolic links, links found while walking are
+  // followed to files only, so a link to a parent directory cannot loop
+
+  if (((nested == 0) && (stat(path, &status) < 0)) ||
+      ((nested != 0) && (lstat(path, &status) < 0)))
+  {
+    AppendCheckResult(list, path, CHECK_ERROR_OPEN);
+    return;
+  }
+
+  if (S_ISLNK(status.st_mode) &&
+      ((stat(path, &status) < 0) ||
+       (S_ISDIR(status.st_mode))))
+    return;
+
+  if (S_ISDIR(status.st_mode))
+  {
+    directory = opendir(path);
+
+    if (directory == NULL)
+    {
+      AppendCheckResult(list, path, CHECK_ERROR_OPEN);
+      return;
+    }
+
+    while ((entry = readdir(directory)) != NULL)
+    {
+      if (entry->d_name[0] == '.')
+        continue;
+
+      name = (char*)malloc(strlen(path) + strlen(entry->d_name) + 2);
+      sprintf(name, "%s/%s", path, entry->d_name);
+      AddCheckPath(list, name, 1);
+      free(name);
+    }
+
+    closedir(directory);
+    return;
+  }
+
+  if (S_ISREG(status.st_mode))
+    AppendCheckResult(list, path, CHECK_ERROR_SUCCESS);
+  else if (nested == 0)
+    AppendCheckResult(list, path, CHECK_ERROR_OPEN);
+}
+
+static void* ExecuteFileCheck(void* argument)
+{
+  struct CheckList* list = (struct CheckList*)argument;
+  size_t index;
+
+  while ((index = __atomic_fetch_add(&list->next, 1, __ATOMIC_RELAXED)) < list->count)
+    if (list->results[index].error == CHECK_ERROR_SUCCESS)
+      CheckFile(list->results + index, list->size);
+
+  return NULL;
+}
+
+static void FormatDuration(char* buffer, size_t length, size_t frames)
+{
+  size_t value = frames * INPUT_FRAME_DURATION;
+
+  snprintf(buffer, length, "%zu:%02zu:%02zu.%03zu",
+    value / 3600000,
+    value / 60000 % 60,
+    value / 1000 % 60,
+    value % 1000);
+}
+
+static int ReportFileCheck(struct CheckResult* result)
+{
+  char duration[32];
+  char silence[32];
+
+  switch (result->error)
+  {
+    case CHECK_ERROR_OPEN:
+      printf("%s: ERROR cannot read file\n", result->path);
+      return 1;
+
+    case CHECK_ERROR_EMPTY:
+      printf("%s: ERROR no data\n", result->path);
+      return 1;
+
+    case CHECK_ERROR_COMPRESSION:
+      printf("%s: ERROR compression is not supported by this build\n", result->path);
+      return 1;
+
+    case CHECK_ERROR_DATA:
+      printf("%s: ERROR compressed data is corrupt or truncated\n", result->path);
+      return 1;
+  }
+
+  FormatDuration(duration, sizeof(duration), result->packets * PACKET_FRAME_COUNT);
+  FormatDuration(silence, sizeof(silence), result->longest);
+
+  printf("%s: %s%s, %zu frames, air time %s, silence %zu frames in %zu long runs (longest %s), %zu errored frames (longest run %zu)",
+    result->path,
+    (result->size == DSD_AMBE_CHUNK_SIZE) ? "DSD" : (result->size == LINEAR_FRAME_SIZE) ? "linear" : "mode33",
+    (result->frames == 0) ? " (empty)" : "",
+    result->frames,
+    duration,
+    result->silence,
+    result->runs,
+    silence,
+    result->erasures,
+    result->burst);
+
+  if (result->remainder > 0)
+    printf(", %zu frames dropped at the end", result->remainder);
+
+  if (result->dropped > 0)
+  {
+    // Only whole packets are sent, so compaction saves air time by packets
+    FormatDuration(duration, sizeof(duration), (result->frames - result->dropped) / PACKET_FRAME_COUNT * PACKET_FRAME_COUNT);
+    FormatDuration(silence, sizeof(silence), (result->packets - (result->frames - result->dropped) / PACKET_FRAME_COUNT) * PACKET_FRAME_COUNT);
+    printf(", compacted air time %s (%zu silence frames removed, %s saved)", duration, result->dropped, silence);
+  }
+
+  if (result->partial > 0)
+  {
+    printf(", WARNING %zu trailing bytes (truncated or misaligned)\n", result->partial);
+    return 1;
+  }
+
+  printf("\n");
+  return (result->frames == 0);
+}
+
+int RunFileCheck(int argc, char* argv[])
+{
+  struct CheckList list;
+  pthread_t* threads;
+  size_t count = 0;
+  size_t limit;
+  size_t started;
+  size_t index;
+  ssize_t position;
+  int selection;
+  int failures = 0;
+  int invalid = 0;
+
+  struct option options[] =
+  {
+    { "linear",      no_argument,       NULL, 'l' },
+    { "mode33",      no_argument,       NULL, 'm' },
+    { "jobs",        required_argument, NULL, 'j' },
+    { "max-silence", required_argument, NULL, 'q' },
+    { NULL,          0,                 NULL, 0   }
+  };
+
+  memset(&list, 0, sizeof(struct CheckList));
+
+  while ((selection = getopt_long(argc, argv, "lmj:q:", options, NULL)) != EOF)
+    switch (selection)
+    {
+      case 'l':
+        list.size = LINEAR_FRAME_SIZE;
+        break;
+
+      case 'm':
+        list.size = MODE33_FRAME_SIZE;
+        break;
+
+      case 'j':
+        position = strtol(optarg, NULL, 10);
+        count    = (position > 0) ? position : 0;
+        invalid |= (position < 1);
+        break;
+
+      case 'q':
+        position   = ParseInputPosition(optarg);
+        list.limit = (position > 0) ? position : 0;
+        invalid   |= (position < 0);
+        break;
+    }
+
+  if ((optind >= argc) ||
+      (invalid != 0))
+  {
+    printf(
+      "Usage:\n"
+      "  digestplay check [--linear | --mode33] [--jobs <number of threads>] [--max-silence <longest silence run kept>] <file or directory>...\n"
+      "\n");
+    return EXIT_FAILURE;
+  }
+
+  for (index = optind; index < argc; index ++)
+    AddCheckPath(&list, argv[index], 0);
+
+  position = sysconf(_SC_NPROCESSORS_ONLN);
+  limit    = (position > 0) ? position : 1;
+
+  if (count == 0)
+    count = limit;
+  if (count > (limit * THREAD_FACTOR))
+    count = limit * THREAD_FACTOR;
+  if (count > list.count)
+    count = list.count;
+
+  // Files are taken one by one from the shared list, results keep the original order
+
+  threads = (pthread_t*)alloca(count * sizeof(pthread_t));
+
+  for (started = 0; started < count; started ++)
+    if (pthread_create(threads + started, NULL, ExecuteFileCheck, &list) != 0)
+      break;
+
+  // Without any worker the files are checked here
+
+  if (started == 0)
+    ExecuteFileCheck(&list);
+
+  for (index = 0; index < started; index ++)
+    pthread_join(threads[index], NULL);
+
+  for (index = 0; index < list.count; index ++)
+  {
+    failures += ReportFileCheck(list.results + index);
+    free(list.results[index].path);
+  }
+
+  printf("Checked %zu files, %i with problems\n", list.count, failures);
+
+  free(list.results);
+  return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
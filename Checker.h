@@ -0,0 +1,52 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CHECK_ERROR_SUCCESS        0
+#define CHECK_ERROR_OPEN          -1
+#define CHECK_ERROR_EMPTY         -2
+#define CHECK_ERROR_COMPRESSION   -3
+#define CHECK_ERROR_DATA          -4
+
+#define CHECK_SILENCE_THRESHOLD   50
+
+struct CheckResult
+{
+  char* path;
+  int error;
+  size_t size;        // Frame size of detected format
+
+  size_t frames;
+  size_t packets;     // Packets of three frames actually transmitted
+  size_t remainder;   // Frames that do not fill the last packet
+  size_t partial;     // Trailing bytes that do not form a frame
+
+  size_t silence;     // Silence frames in total
+  size_t runs;        // Silence runs of at least CHECK_SILENCE_THRESHOLD frames
+  size_t longest;     // Longest silence run in frames
+
+  size_t limit;       // Longest silence run kept by --max-silence, 0 for none
+  size_t dropped;     // Silence frames that compaction removes
+
+  size_t erasures;    // Frames marked with bit errors
+  size_t burst;       // Longest run of such frames
+};
+
+void CheckBuffer(struct CheckResult* result, const uint8_t* data, size_t length, size_t size);
+void CheckFile(struct CheckResult* result, size_t size);
+
+// Entry point of "digestplay check [--linear|--mode33] [--jobs <n>] <file or directory>..."
+int RunFileCheck(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
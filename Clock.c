@@ -0,0 +1,110 @@
+#include "Clock.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/timerfd.h>
+
+static uint64_t GetMonotonicTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+int InitializeClock(struct Clock* clock, int mode)
+{
+  memset(clock, 0, sizeof(struct Clock));
+
+  clock->mode   = mode;
+  clock->handle = -1;
+
+  if (mode == CLOCK_MODE_REAL)
+  {
+    clock->handle = timerfd_create(CLOCK_MONOTONIC, 0);
+    if (clock->handle < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+void ReleaseClock(struct Clock* clock)
+{
+  if (clock->handle >= 0)
+  {
+    close(clock->handle);
+    clock->handle = -1;
+  }
+}
+
+uint64_t GetClockTime(struct Clock* clock)
+{
+  if ((clock == NULL) ||
+      (clock->mode == CLOCK_MODE_REAL))
+    return GetMonotonicTime();
+
+  // Virtual time still follows real time, so receive timeouts expire as usual
+  return GetMonotonicTime() + clock->time;
+}
+
+void SleepClock(struct Clock* clock, uint64_t interval)
+{
+  struct timespec value;
+
+  if ((clock == NULL) ||
+      (clock->mode == CLOCK_MODE_REAL))
+  {
+    value.tv_sec  = interval / NANOSECONDS_PER_SECOND;
+    value.tv_nsec = interval % NANOSECONDS_PER_SECOND;
+    nanosleep(&value, NULL);
+    return;
+  }
+
+  clock->time += interval;
+
+  if (clock->hook != NULL)
+    clock->hook(clock->data);
+}
+
+int StartClockTicks(struct Clock* clock, uint64_t period, uint64_t delay)
+{
+  struct itimerspec interval;
+
+  clock->period = period;
+  clock->delay  = delay;
+
+  if (clock->mode == CLOCK_MODE_VIRTUAL)
+    return 0;
+
+  // Zero value disarms timerfd, so the shortest possible delay stands for an immediate tick
+
+  if (delay == 0)
+    delay = 1;
+
+  interval.it_interval.tv_sec  = period / NANOSECONDS_PER_SECOND;
+  interval.it_interval.tv_nsec = period % NANOSECONDS_PER_SECOND;
+
+  interval.it_value.tv_sec  = delay / NANOSECONDS_PER_SECOND;
+  interval.it_value.tv_nsec = delay % NANOSECONDS_PER_SECOND;
+
+  return timerfd_settime(clock->handle, 0, &interval, NULL);
+}
+
+ssize_t WaitForClockTick(struct Clock* clock)
+{
+  uint64_t mark;
+
+  if (clock->mode == CLOCK_MODE_REAL)
+  {
+    if (read(clock->handle, &mark, sizeof(uint64_t)) != sizeof(uint64_t))
+      return -1;
+
+    return mark;
+  }
+
+  SleepClock(clock, clock->delay);
+  clock->delay = clock->period;
+  return 1;
+}
@@ -0,0 +1,50 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CLOCK_MODE_REAL       0
+#define CLOCK_MODE_VIRTUAL    1
+
+#define NANOSECONDS_PER_SECOND       1000000000ULL
+#define NANOSECONDS_PER_MILLISECOND  1000000ULL
+
+typedef void (*ClockHook)(void* data);
+
+// Real mode paces ticks with a timerfd, virtual mode skips every wait by
+// adding it to the offset in <time> and calls the hook to let a peer catch up
+
+struct Clock
+{
+  int mode;
+  int handle;
+  uint64_t period;
+  uint64_t delay;   // Interval to the next virtual tick
+  uint64_t time;
+
+  ClockHook hook;
+  void* data;
+};
+
+int InitializeClock(struct Clock* clock, int mode);
+void ReleaseClock(struct Clock* clock);
+
+// Functions accept NULL as the real clock without ticks
+uint64_t GetClockTime(struct Clock* clock);
+void SleepClock(struct Clock* clock, uint64_t interval);
+
+// First tick comes after <delay>, 0 makes it due at once to align it with what was just sent
+int StartClockTicks(struct Clock* clock, uint64_t period, uint64_t delay);
+ssize_t WaitForClockTick(struct Clock* clock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,388 @@
+#include "Decompressor.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <sys/eventfd.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#define CHUNK_SIZE  (64 * 1024)
+
+static const uint8_t gzipMagic[] = { 0x1f, 0x8b };
+static const uint8_t zstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+int DetectCompression(const uint8_t* data, size_t length)
+{
+  if ((length >= sizeof(gzipMagic)) &&
+      (memcmp(data, gzipMagic, sizeof(gzipMagic)) == 0))
+    return COMPRESSION_GZIP;
+
+  if ((length >= sizeof(zstdMagic)) &&
+      (memcmp(data, zstdMagic, sizeof(zstdMagic)) == 0))
+    return COMPRESSION_ZSTD;
+
+  return COMPRESSION_NONE;
+}
+
+static ssize_t ReadSourceData(struct Decompressor* decompressor, uint8_t* data, size_t length)
+{
+  struct pollfd events[2];
+  size_t count = decompressor->rest;
+
+  // Hand over bytes consumed by format detection first
+
+  if (count > 0)
+  {
+    memcpy(data, decompressor->prefix, count);
+    decompressor->rest = 0;
+    return count;
+  }
+
+  // A slow pipe must not keep ReleaseDecompressor waiting, so wait for either the source or release
+
+  events[0].fd     = decompressor->handle;
+  events[0].events = POLLIN;
+  events[1].fd     = decompressor->event;
+  events[1].events = POLLIN;
+
+  while (poll(events, 2, -1) < 0)
+    if (errno != EINTR)
+      return -1;
+
+  if (events[1].revents & POLLIN)
+    return 0;
+
+  return read(decompressor->handle, data, length);
+}
+
+static int PushDecompressedData(struct Decompressor* decompressor, const uint8_t* data, size_t length)
+{
+  size_t offset;
+  size_t count;
+
+  while (length > 0)
+  {
+    pthread_mutex_lock(&decompressor->lock);
+
+    while ((decompressor->stop == 0) &&
+           ((decompressor->tail - decompressor->head) == DECOMPRESSOR_BUFFER_SIZE))
+      pthread_cond_wait(&decompressor->condition, &decompressor->lock);
+
+    if (decompressor->stop != 0)
+    {
+      pthread_mutex_unlock(&decompressor->lock);
+      return -1;
+    }
+
+    offset = decompressor->tail % DECOMPRESSOR_BUFFER_SIZE;
+    count  = DECOMPRESSOR_BUFFER_SIZE - (decompressor->tail - decompressor->head);
+
+    pthread_mutex_unlock(&decompressor->lock);
+
+    // Only the producer moves the tail, so the free space can be filled without the lock
+
+    if (count > (DECOMPRESSOR_BUFFER_SIZE - offset))
+      count = DECOMPRESSOR_BUFFER_SIZE - offset;
+    if (count > length)
+      count = length;
+
+    memcpy(decompressor->buffer + offset, data, count);
+
+    pthread_mutex_lock(&decompressor->lock);
+    decompressor->tail += count;
+    pthread_cond_broadcast(&decompressor->condition);
+    pthread_mutex_unlock(&decompressor->lock);
+
+    data   += count;
+    length -= count;
+  }
+
+  return 0;
+}
+
+#ifdef USE_ZLIB
+static int InflateGZipData(struct Decompressor* decompressor, uint8_t* input, uint8_t* output)
+{
+  z_stream stream;
+  ssize_t length;
+  int result = Z_OK;
+
+  memset(&stream, 0, sizeof(z_stream));
+
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    return DECOMPRESSOR_ERROR_CORRUPT;
+
+  while ((length = ReadSourceData(decompressor, input, CHUNK_SIZE)) > 0)
+  {
+    stream.next_in  = input;
+    stream.avail_in = length;
+
+    while (stream.avail_in > 0)
+    {
+      stream.next_out  = output;
+      stream.avail_out = CHUNK_SIZE;
+
+      result = inflate(&stream, Z_NO_FLUSH);
+
+      // Data inflated before a damaged block is still handed over
+
+      if (PushDecompressedData(decompressor, output, CHUNK_SIZE - stream.avail_out) < 0)
+      {
+        inflateEnd(&stream);
+        return 0;
+      }
+
+      if ((result != Z_OK) &&
+          (result != Z_STREAM_END) &&
+          (result != Z_BUF_ERROR))
+      {
+        inflateEnd(&stream);
+        return DECOMPRESSOR_ERROR_CORRUPT;
+      }
+
+      // Files produced by cat *.gz contain several members
+      if (result == Z_STREAM_END)
+        inflateReset(&stream);
+    }
+  }
+
+  inflateEnd(&stream);
+
+  if (length < 0)
+    return DECOMPRESSOR_ERROR_READ;
+
+  // Data that stops before the end of the last member is truncated
+
+  if (result != Z_STREAM_END)
+    return DECOMPRESSOR_ERROR_TRUNCATED;
+
+  return 0;
+}
+#endif
+
+#ifdef USE_ZSTD
+static int InflateZStandardData(struct Decompressor* decompressor, uint8_t* input, uint8_t* output)
+{
+  ZSTD_DStream* stream;
+  ZSTD_inBuffer source;
+  ZSTD_outBuffer target;
+  ssize_t length;
+  size_t result = 1;
+
+  stream = ZSTD_createDStream();
+
+  if ((stream == NULL) ||
+      (ZSTD_isError(ZSTD_initDStream(stream))))
+  {
+    ZSTD_freeDStream(stream);
+    return DECOMPRESSOR_ERROR_CORRUPT;
+  }
+
+  while ((length = ReadSourceData(decompressor, input, CHUNK_SIZE)) > 0)
+  {
+    source.src  = input;
+    source.size = length;
+    source.pos  = 0;
+
+    while (source.pos < source.size)
+    {
+      target.dst  = output;
+      target.size = CHUNK_SIZE;
+      target.pos  = 0;
+
+      result = ZSTD_decompressStream(stream, &target, &source);
+
+      if (ZSTD_isError(result))
+      {
+        ZSTD_freeDStream(stream);
+        return DECOMPRESSOR_ERROR_CORRUPT;
+      }
+
+      if (PushDecompressedData(decompressor, output, target.pos) < 0)
+      {
+        ZSTD_freeDStream(stream);
+        return 0;
+      }
+    }
+  }
+
+  ZSTD_freeDStream(stream);
+
+  if (length < 0)
+    return DECOMPRESSOR_ERROR_READ;
+
+  // Decoder returns 0 only when a frame is complete
+
+  if (result != 0)
+    return DECOMPRESSOR_ERROR_TRUNCATED;
+
+  return 0;
+}
+#endif
+
+static void* ExecuteDecompressor(void* argument)
+{
+  struct Decompressor* decompressor = (struct Decompressor*)argument;
+  uint8_t* input  = (uint8_t*)malloc(CHUNK_SIZE);
+  uint8_t* output = (uint8_t*)malloc(CHUNK_SIZE);
+  int result = DECOMPRESSOR_ERROR_READ;
+
+  if ((input != NULL) &&
+      (output != NULL))
+  {
+    switch (decompressor->format)
+    {
+#ifdef USE_ZLIB
+      case COMPRESSION_GZIP:
+        result = InflateGZipData(decompressor, input, output);
+        break;
+#endif
+
+#ifdef USE_ZSTD
+      case COMPRESSION_ZSTD:
+        result = InflateZStandardData(decompressor, input, output);
+        break;
+#endif
+    }
+  }
+
+  free(input);
+  free(output);
+
+  pthread_mutex_lock(&decompressor->lock);
+  decompressor->state = result;
+  pthread_cond_broadcast(&decompressor->condition);
+  pthread_mutex_unlock(&decompressor->lock);
+
+  return NULL;
+}
+
+struct Decompressor* CreateDecompressor(int format, int handle, const uint8_t* prefix, size_t length)
+{
+  struct Decompressor* decompressor;
+
+#ifndef USE_ZLIB
+  if (format == COMPRESSION_GZIP)
+    return NULL;
+#endif
+
+#ifndef USE_ZSTD
+  if (format == COMPRESSION_ZSTD)
+    return NULL;
+#endif
+
+  if ((format == COMPRESSION_NONE) ||
+      (length > COMPRESSION_MAGIC_SIZE))
+    return NULL;
+
+  decompressor = (struct Decompressor*)calloc(1, sizeof(struct Decompressor));
+
+  if (decompressor == NULL)
+    return NULL;
+
+  decompressor->format = format;
+  decompressor->handle = handle;
+  decompressor->state  = 1;
+  decompressor->rest   = length;
+  decompressor->buffer = (uint8_t*)malloc(DECOMPRESSOR_BUFFER_SIZE);
+  decompressor->event  = eventfd(0, EFD_NONBLOCK);
+
+  memcpy(decompressor->prefix, prefix, length);
+
+  pthread_mutex_init(&decompressor->lock, NULL);
+  pthread_cond_init(&decompressor->condition, NULL);
+
+  if ((decompressor->buffer == NULL) ||
+      (decompressor->event < 0) ||
+      (pthread_create(&decompressor->thread, NULL, ExecuteDecompressor, decompressor) != 0))
+  {
+    close(decompressor->event);
+    pthread_cond_destroy(&decompressor->condition);
+    pthread_mutex_destroy(&decompressor->lock);
+    free(decompressor->buffer);
+    free(decompressor);
+    return NULL;
+  }
+
+  return decompressor;
+}
+
+void ReleaseDecompressor(struct Decompressor* decompressor)
+{
+  uint64_t value = 1;
+
+  if (decompressor != NULL)
+  {
+    pthread_mutex_lock(&decompressor->lock);
+    decompressor->stop = 1;
+    pthread_cond_broadcast(&decompressor->condition);
+    pthread_mutex_unlock(&decompressor->lock);
+
+    write(decompressor->event, &value, sizeof(uint64_t));
+    pthread_join(decompressor->thread, NULL);
+
+    close(decompressor->event);
+    pthread_cond_destroy(&decompressor->condition);
+    pthread_mutex_destroy(&decompressor->lock);
+    free(decompressor->buffer);
+    free(decompressor);
+  }
+}
+
+size_t ReadDecompressor(struct Decompressor* decompressor, uint8_t* data, size_t length)
+{
+  size_t number = 0;
+  size_t offset;
+  size_t count;
+
+  pthread_mutex_lock(&decompressor->lock);
+
+  while (number < length)
+  {
+    while ((decompressor->state > 0) &&
+           (decompressor->tail == decompressor->head))
+      pthread_cond_wait(&decompressor->condition, &decompressor->lock);
+
+    if (decompressor->tail == decompressor->head)
+      break;
+
+    offset = decompressor->head % DECOMPRESSOR_BUFFER_SIZE;
+    count  = decompressor->tail - decompressor->head;
+
+    if (count > (DECOMPRESSOR_BUFFER_SIZE - offset))
+      count = DECOMPRESSOR_BUFFER_SIZE - offset;
+    if (count > (length - number))
+      count = length - number;
+
+    memcpy(data + number, decompressor->buffer + offset, count);
+
+    decompressor->head += count;
+    number += count;
+  }
+
+  pthread_cond_broadcast(&decompressor->condition);
+  pthread_mutex_unlock(&decompressor->lock);
+
+  return number;
+}
+
+int GetDecompressorState(struct Decompressor* decompressor)
+{
+  int state;
+
+  pthread_mutex_lock(&decompressor->lock);
+  state = decompressor->state;
+  pthread_mutex_unlock(&decompressor->lock);
+
+  return state;
+}
@@ -0,0 +1,63 @@
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define COMPRESSION_NONE           0
+#define COMPRESSION_GZIP           1
+#define COMPRESSION_ZSTD           2
+
+#define COMPRESSION_MAGIC_SIZE     4
+
+#define DECOMPRESSOR_BUFFER_SIZE   (256 * 1024)
+
+#define DECOMPRESSOR_ERROR_READ       -1  // Reading the source failed
+#define DECOMPRESSOR_ERROR_CORRUPT    -2  // Decoder rejected the data
+#define DECOMPRESSOR_ERROR_TRUNCATED  -3  // Source ended inside a compressed frame
+
+// Background stage that inflates a compressed input into a ring buffer,
+// so the playback loop only copies ready frames
+
+struct Decompressor
+{
+  int format;
+  int handle;
+
+  uint8_t prefix[COMPRESSION_MAGIC_SIZE];
+  size_t rest;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t condition;
+  int event;  // eventfd that wakes the stage from a blocking read on release
+
+  uint8_t* buffer;
+  size_t head;
+  size_t tail;
+
+  int state;  // 1 while running, 0 at the end of data, DECOMPRESSOR_ERROR_* on error
+  int stop;
+};
+
+int DetectCompression(const uint8_t* data, size_t length);
+
+struct Decompressor* CreateDecompressor(int format, int handle, const uint8_t* prefix, size_t length);
+void ReleaseDecompressor(struct Decompressor* decompressor);
+
+size_t ReadDecompressor(struct Decompressor* decompressor, uint8_t* data, size_t length);
+
+// Returns 1 while data may follow, 0 at a clean end, DECOMPRESSOR_ERROR_* once decompression failed
+int GetDecompressorState(struct Decompressor* decompressor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
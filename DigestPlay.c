@@ -2,22 +2,33 @@
 #include <string.h>
 #include <stdio.h>
 
+#include <fcntl.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <pthread.h>
 #include <sys/time.h>
-#include <sys/timerfd.h>
+#include <sys/stat.h>
 
 #include "Version.h"
 #include "RewindClient.h"
+#include "Simulator.h"
+#include "Checker.h"
+#include "Library.h"
+#include "Planner.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "Usage.h"
+#include "Input.h"
+#include "AMBE.h"
+#include "Clock.h"
+#include "Log.h"
 
 #define TDMA_FRAME_DURATION   60
+#define SUPERFRAME_LENGTH     6
+#define FRAMES_PER_PACKET     3
 
-#define DSD_MAGIC_TEXT        ".amb"
-#define DSD_MAGIC_SIZE        4
-#define DSD_AMBE_CHUNK_SIZE   8
-
-#define LINEAR_FRAME_SIZE     7
-#define MODE33_FRAME_SIZE     9
+#define RESUME_RECORD_FORMAT  "%020zu\n"
+#define RESUME_RECORD_SIZE    21
 
 #define HELPER(value)         #value
 #define STRING(value)         HELPER(value)
@@ -25,10 +36,124 @@
 #define COUNT(array)          sizeof(array) / sizeof(array[0])
 
 #define BUFFER_SIZE           64
+#define PREROLL_LENGTH        (2 * SUPERFRAME_LENGTH)
 #define CLIENT_NAME           "DigestPlay " STRING(VERSION) " " BUILD
 
+// Packets read and converted while login is in flight, so the first frames
+// go out right behind the voice header without waiting for input
+
+struct Preroll
+{
+  pthread_t thread;
+  int state;
+  struct InputStream* input;
+  size_t size;
+  size_t format;
+  size_t count;
+  size_t index;
+  struct SilenceFilter* filter;
+  size_t positions[PREROLL_LENGTH];
+  uint8_t data[PREROLL_LENGTH * FRAMES_PER_PACKET * MODE33_FRAME_SIZE];
+};
+
+struct Simulation
+{
+  struct Simulator* simulator;
+  struct RewindContext* context;
+};
+
+static void TransmitVoiceHeader(struct RewindContext* context, struct RewindSuperHeader* header)
+{
+  TransmitRewindData(context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, header, sizeof(struct RewindSuperHeader));
+  TransmitRewindData(context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, header, sizeof(struct RewindSuperHeader));
+  TransmitRewindData(context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, header, sizeof(struct RewindSuperHeader));
+}
+
+static void* ReadPreroll(void* argument)
+{
+  struct Preroll* preroll = (struct Preroll*)argument;
+  uint8_t buffer[FRAMES_PER_PACKET * MODE33_FRAME_SIZE];
+  uint8_t* destination;
+
+  while ((preroll->count < PREROLL_LENGTH) &&
+         (ReadFilteredFrames(preroll->input, preroll->filter, buffer, FRAMES_PER_PACKET) == FRAMES_PER_PACKET))
+  {
+    // Compaction makes packets cover more input, keep where each one ends
+    preroll->positions[preroll->count] = preroll->input->position;
+
+    destination = preroll->data + preroll->count * FRAMES_PER_PACKET * preroll->format;
+
+    if (preroll->size != preroll->format)
+      TranscodeAMBEFrames(destination, preroll->format, buffer, preroll->size, FRAMES_PER_PACKET);
+    else
+      memcpy(destination, buffer, FRAMES_PER_PACKET * preroll->format);
+
+    preroll->count ++;
+  }
+
+  return NULL;
+}
+
+static int CheckPrerollInput(struct InputStream* input)
+{
+  struct stat status;
+
+  // Memory and regular files always give data, a stalled pipe would keep
+  // the reading thread from being joined on an early exit
+
+  if (input->map != NULL)
+    return 1;
+
+  return
+    (fstat(input->handle, &status) == 0) &&
+    (S_ISREG(status.st_mode));
+}
+
+static void FinishPreroll(struct Preroll* preroll)
+{
+  if (preroll->state != 0)
+  {
+    pthread_join(preroll->thread, NULL);
+    preroll->state = 0;
+  }
+}
+
+static void SynchronizeSimulation(void* data)
+{
+  struct Simulation* simulation = (struct Simulation*)data;
+  SynchronizeSimulator(simulation->simulator, simulation->context->transmission.packets);
+}
+
 int main(int argc, char* argv[])
 {
+  if ((argc > 1) &&
+      (strcmp(argv[1], "check") == 0))
+  {
+    // Validate files instead of playing
+    return RunFileCheck(argc - 1, argv + 1);
+  }
+
+  if ((argc > 1) &&
+      (strcmp(argv[1], "pack") == 0))
+  {
+    // Build clip library instead of playing
+    return RunLibraryPack(argc - 1, argv + 1);
+  }
+
+  if ((argc > 1) &&
+      (strcmp(argv[1], "schedule") == 0))
+  {
+    // Run a queue of bulletins for several TGs
+    return RunPlannerSchedule(argc - 1, argv + 1);
+  }
+
+  if ((argc > 1) &&
+      (strcmp(argv[1], "trace") == 0))
+  {
+    // Analyze packet trace of an earlier playout
+    return RunTraceAnalysis(argc - 1, argv + 1);
+  }
+
   printf("\n");
   printf("DigestPlay for BrandMeister DMR Master Server\n");
   printf("Copyright 2017 Artem Prilutskiy (R3ABM, cyanide.burnout@gmail.com)\n");
@@ -43,14 +168,54 @@ int main(int argc, char* argv[])
   const char* password = NULL;
 
   size_t size = DSD_AMBE_CHUNK_SIZE;
+  size_t format = 0;
 
   struct RewindSuperHeader header;
   memset(&header, 0, sizeof(struct RewindSuperHeader));
 
   time_t interval1 = 0;
   time_t interval2 = 0;
+  uint32_t retry = 0;
+  uint32_t liveness = 3;
+  uint32_t attempts = 0;
+
+  ssize_t start = -1;
+  ssize_t duration = -1;
+  const char* resume = NULL;
+  int record = -1;
+  char text[RESUME_RECORD_SIZE + 1];
+
+  struct InputStream input;
+  struct Preroll preroll;
+  uint8_t* payload;
+  uint64_t moment;
+  uint64_t marks[2];
+
+  const char* path = NULL;
+  const char* name = NULL;
+  const uint8_t* clip;
+  size_t frames = 0;
+  struct Library library;
+
+  ssize_t quiet = 0;
+  struct SilenceFilter filter;
+
+  int mode = CLOCK_MODE_REAL;
+  struct Clock clock;
+  struct Simulation simulation;
   struct RewindSessionPollData poll;
 
+  const char* address = NULL;
+  struct MetricsServer* metrics = NULL;
+  struct MetricsSession session;
+  ssize_t ticks;
+
+  int statistics = 0;
+  struct UsageMonitor* monitor = NULL;
+
+  const char* journal = NULL;
+  struct Trace trace;
+
   // Start up
 
   struct option options[] =
@@ -66,14 +231,30 @@ int main(int argc, char* argv[])
     { "pause",            required_argument, NULL, 'e' },
     { "linear",           no_argument,       NULL, 'l' },
     { "mode33",           no_argument,       NULL, 'm' },
+    { "send-retry",       required_argument, NULL, 'r' },
+    { "simulate",         no_argument,       NULL, 'x' },
+    { "start-at",         required_argument, NULL, 'a' },
+    { "duration",         required_argument, NULL, 'd' },
+    { "resume",           required_argument, NULL, 'z' },
+    { "metrics",          required_argument, NULL, 'M' },
+    { "liveness",         required_argument, NULL, 'L' },
+    { "reconnect",        required_argument, NULL, 'R' },
+    { "transmit",         required_argument, NULL, 'T' },
+    { "stats",            no_argument,       NULL, 'S' },
+    { "library",          required_argument, NULL, 'B' },
+    { "clip",             required_argument, NULL, 'K' },
+    { "max-silence",      required_argument, NULL, 'q' },
+    { "trace",            required_argument, NULL, 'P' },
     { NULL,               0,                 NULL, 0   }
   };
 
   int value = 0;
+  int result = 0;
   int control = 0;
+  int invalid = 0;
   int selection = 0;
 
-  while ((selection = getopt_long(argc, argv, "w:c:s:p:u:g:t:o:e:lm", options, NULL)) != EOF)
+  while ((selection = getopt_long(argc, argv, "w:c:s:p:u:g:t:o:e:lmr:xa:d:z:M:L:R:T:SB:K:q:P:", options, NULL)) != EOF)
     switch (selection)
     {
       case 'w':
@@ -133,9 +314,74 @@ int main(int argc, char* argv[])
       case 'm':
         size = MODE33_FRAME_SIZE;
         break;
+
+      case 'r':
+        value   = strtol(optarg, NULL, 10);
+        retry   = value * 1000;
+        invalid |= (value < 0) || (retry > REWIND_RETRY_LIMIT);
+        break;
+
+      case 'x':
+        mode = CLOCK_MODE_VIRTUAL;
+        password = "simulation";
+        control |= 0b00011;
+        break;
+
+      case 'a':
+        start = ParseInputPosition(optarg);
+        invalid |= (start < 0);
+        break;
+
+      case 'd':
+        duration = ParseInputPosition(optarg);
+        invalid |= (duration < 0);
+        break;
+
+      case 'z':
+        resume = optarg;
+        break;
+
+      case 'M':
+        address = optarg;
+        break;
+
+      case 'L':
+        liveness = strtol(optarg, NULL, 10);
+        break;
+
+      case 'R':
+        attempts = strtol(optarg, NULL, 10);
+        break;
+
+      case 'T':
+        format   = (strcmp(optarg, "linear") == 0) ? LINEAR_FRAME_SIZE : (strcmp(optarg, "mode33") == 0) ? MODE33_FRAME_SIZE : 0;
+        invalid |= (format == 0);
+        break;
+
+      case 'S':
+        statistics = 1;
+        break;
+
+      case 'B':
+        path = optarg;
+        break;
+
+      case 'K':
+        name = optarg;
+        break;
+
+      case 'q':
+        quiet = ParseInputPosition(optarg);
+        invalid |= (quiet < 0);
+        break;
+
+      case 'P':
+        journal = optarg;
+        break;
     }
 
-  if (control != 0b11111)
+  if ((control != 0b11111) ||
+      (invalid != 0))
   {
     printf(
       "Usage:\n"
@@ -149,46 +395,264 @@ int main(int argc, char* argv[])
       "    --talker-alias <text to send as Talker Alias>\n"
       "    --linear (use AMBE linear format instead of DSD)\n"
       "    --mode33 (use AMBE mode 33 format instead of DSD)\n"
+      "    --transmit <linear | mode33> (format to send, transcoded from input format if required)\n"
       "    --wait <interval in seconds>\n"
       "    --pause <interval in seconds>\n"
+      "    --send-retry <time budget in milliseconds to retry a refused send, up to 40>\n"
+      "    --simulate (play faster than real time to a local stand-in server and check the stream)\n"
+      "    --start-at <position: seconds, [hh:]mm:ss, <n>ms or <n>f for AMBE frames>\n"
+      "    --duration <length in the same units as --start-at>\n"
+      "    --resume <file to keep position of interrupted playout>\n"
+      "    --metrics <[host:]port or unix:<path> to serve OpenMetrics text on>\n"
+      "    --liveness <unanswered keep-alives to consider the server dead, 0 to disable, default 3>\n"
+      "    --reconnect <number of attempts to reconnect to a dead server instead of aborting>\n"
+      "    --stats (report CPU time, context switches and available perf counters per phase at exit)\n"
+      "    --library <clip library built by pack> --clip <name> (play a clip instead of standard input)\n"
+      "    --max-silence <longest run of silence to send, in the same units as --start-at>\n"
+      "    --trace <file to record headers of all packets sent and received to>\n"
+      "\n"
+      "  %s check [--linear | --mode33] [--jobs <number of threads>] [--max-silence <length>] <file or directory>...\n"
+      "  %s pack [--linear | --mode33] [--output linear | mode33] <library> <file or directory>...\n"
+      "  %s schedule <connection options> [--slots <bulletins on air at once>] <job file>\n"
+      "  %s trace <file written with --trace>\n"
       "\n",
+      argv[0],
+      argv[0],
+      argv[0],
+      argv[0],
       argv[0]);
     return EXIT_FAILURE;
   }
 
+  // Counters inherit only into threads started after them, so open them first
+
+  if (statistics != 0)
+    monitor = CreateUsageMonitor();
+
+  // Start status and logging channel
+
+  if (StartLog() < 0)
+  {
+    printf("Error starting log\n");
+    ReleaseUsageMonitor(monitor);
+    return EXIT_FAILURE;
+  }
+
   // Create Rewind client context
 
   struct RewindContext* context = CreateRewindContext(number, CLIENT_NAME);
 
   if (context == NULL)
   {
-    printf("Error creating context\n");
+    WriteLog(LOG_CATEGORY_ERROR, "Error creating context\n");
+    ReleaseUsageMonitor(monitor);
+    StopLog();
     return EXIT_FAILURE;
   }
 
+  context->retry    = retry;
+  context->liveness = liveness;
+
+  // Expose counters to scrapers if requested
+
+  memset(&session, 0, sizeof(struct MetricsSession));
+  session.context = context;
+  session.group   = le32toh(header.destinationID);
+  session.source  = le32toh(header.sourceID);
+
+  if ((address != NULL) &&
+      ((metrics = CreateMetricsServer(address)) == NULL))
+  {
+    WriteLog(LOG_CATEGORY_ERROR, "Error starting metrics server\n");
+    ReleaseRewindContext(context);
+    ReleaseUsageMonitor(monitor);
+    StopLog();
+    return EXIT_FAILURE;
+  }
+
+  RegisterMetricsSession(metrics, &session);
+
+  // Set up time source, simulation runs on virtual time against a local stand-in server
+
+  simulation.context   = context;
+  simulation.simulator = NULL;
+
+  if ((InitializeClock(&clock, mode) < 0) ||
+      (mode == CLOCK_MODE_VIRTUAL) &&
+      ((simulation.simulator = CreateSimulator()) == NULL))
+  {
+    WriteLog(LOG_CATEGORY_ERROR, "Error creating clock\n");
+    ReleaseClock(&clock);
+    ReleaseMetricsServer(metrics);
+    ReleaseRewindContext(context);
+    ReleaseUsageMonitor(monitor);
+    StopLog();
+    return EXIT_FAILURE;
+  }
+
+  if (simulation.simulator != NULL)
+  {
+    location   = "::1";
+    port       = simulation.simulator->port;
+    clock.hook = SynchronizeSimulation;
+    clock.data = &simulation;
+  }
+
+  context->clock = &clock;
+
+  // Record packet headers to a ring file if requested
+
+  memset(&trace, 0, sizeof(struct Trace));
+
+  if ((journal != NULL) &&
+      (OpenTrace(&trace, journal, TRACE_DEFAULT_CAPACITY, GetClockTime(&clock)) < 0))
+  {
+    WriteLog(LOG_CATEGORY_ERROR, "Error opening trace file\n");
+    ReleaseSimulator(simulation.simulator);
+    ReleaseClock(&clock);
+    ReleaseMetricsServer(metrics);
+    ReleaseRewindContext(context);
+    ReleaseUsageMonitor(monitor);
+    StopLog();
+    return EXIT_FAILURE;
+  }
+
+  if (journal != NULL)
+    context->trace = &trace;
+
   // Create input stream buffer
 
-  char* buffer = (char*)alloca(BUFFER_SIZE);
+  uint8_t* buffer = (uint8_t*)alloca(BUFFER_SIZE);
+  uint8_t* output = (uint8_t*)alloca(BUFFER_SIZE);
+
+  // Take input from clip library if requested, the clip is played right from the shared mapping
+
+  memset(&library, 0, sizeof(struct Library));
+
+  if ((path != NULL) &&
+      (name != NULL))
+  {
+    if ((OpenLibrary(&library, path) != LIBRARY_ERROR_SUCCESS) ||
+        ((clip = FindLibraryClip(&library, name, &frames)) == NULL))
+    {
+      WriteLog(LOG_CATEGORY_ERROR, "Error finding clip in library\n");
+      CloseLibrary(&library);
+      ReleaseSimulator(simulation.simulator);
+      ReleaseClock(&clock);
+      ReleaseMetricsServer(metrics);
+      CloseTrace(&trace);
+      ReleaseRewindContext(context);
+      ReleaseUsageMonitor(monitor);
+      StopLog();
+      return EXIT_FAILURE;
+    }
+
+    size = le32toh(library.header->size);
+    AttachInputStream(&input, clip, frames, size);
+  }
+
+  // DSD is sent as linear, other formats as they are unless told otherwise
+
+  if (format == 0)
+    format = (size == MODE33_FRAME_SIZE) ? MODE33_FRAME_SIZE : LINEAR_FRAME_SIZE;
+
+  // Open input stream and check data format if possible
 
-  // Check input data format if possible
+  if (library.map == NULL)
+    result = OpenInputStream(&input, STDIN_FILENO, size);
 
-  if ((size == DSD_AMBE_CHUNK_SIZE) &&
-      ((read(STDIN_FILENO, buffer, DSD_MAGIC_SIZE) != DSD_MAGIC_SIZE) ||
-       (memcmp(buffer, DSD_MAGIC_TEXT, DSD_MAGIC_SIZE) != 0)))
+  if (result != INPUT_ERROR_SUCCESS)
   {
-    printf("Error checking input data format\n");
+    WriteLog(LOG_CATEGORY_ERROR,
+      (result == INPUT_ERROR_COMPRESSION) ? "Error starting decompression of input data\n" :
+      (result == INPUT_ERROR_DATA)        ? "Error decompressing input data, it is corrupt or truncated\n" :
+                                            "Error checking input data format\n");
+    ReleaseSimulator(simulation.simulator);
+    ReleaseClock(&clock);
+    ReleaseMetricsServer(metrics);
+    CloseTrace(&trace);
     ReleaseRewindContext(context);
+    ReleaseUsageMonitor(monitor);
+    StopLog();
     return EXIT_FAILURE;
   }
 
+  // Continue interrupted playout unless the position is given explicitly
+
+  if ((resume != NULL) &&
+      ((record = open(resume, O_RDWR | O_CREAT, 0644)) >= 0) &&
+      (start < 0))
+  {
+    memset(text, 0, sizeof(text));
+    if (pread(record, text, RESUME_RECORD_SIZE, 0) > 0)
+    {
+      start = strtoll(text, NULL, 10);
+      WriteLog(LOG_CATEGORY_NOTICE, "Resuming from frame %li\n", (long)start);
+    }
+  }
+
+  if ((start > 0) &&
+      (SeekInputStream(&input, start - start % FRAMES_PER_PACKET) != INPUT_ERROR_SUCCESS))
+  {
+    WriteLog(LOG_CATEGORY_ERROR, "Start position is out of input data\n");
+    close(record);
+    CloseInputStream(&input);
+    CloseLibrary(&library);
+    ReleaseSimulator(simulation.simulator);
+    ReleaseClock(&clock);
+    ReleaseMetricsServer(metrics);
+    CloseTrace(&trace);
+    ReleaseRewindContext(context);
+    ReleaseUsageMonitor(monitor);
+    StopLog();
+    return EXIT_FAILURE;
+  }
+
+  // Silence runs are cut while reading, so pre-read packets are compacted as well
+
+  InitializeSilenceFilter(&filter, size, (quiet > 0) ? quiet : 0);
+
+  // Pre-read the first packets in parallel with login and waiting, input from pipes is read when playing
+
+  preroll.filter = &filter;
+  preroll.input  = &input;
+  preroll.size   = size;
+  preroll.format = format;
+  preroll.count  = 0;
+  preroll.index  = 0;
+
+  preroll.state  = 0;
+
+  if (CheckPrerollInput(&input) != 0)
+  {
+    preroll.state = (pthread_create(&preroll.thread, NULL, ReadPreroll, &preroll) == 0);
+
+    if (preroll.state == 0)
+      ReadPreroll(&preroll);
+  }
+
   // Connect to the server
 
-  int result = ConnectRewindClient(context, location, port, password, 0);
+  moment = GetClockTime(&clock);
+
+  BeginUsagePhase(monitor);
+  result = ConnectRewindClient(context, location, port, password, 0);
+  EndUsagePhase(monitor, USAGE_PHASE_CONNECT);
 
   if (result < 0)
   {
-    printf("Cannot connect to the server (%i)\n", result);
+    WriteLog(LOG_CATEGORY_ERROR, "Cannot connect to the server (%li)\n", (long)result);
+    FinishPreroll(&preroll);
+    close(record);
+    CloseInputStream(&input);
+    CloseLibrary(&library);
+    ReleaseSimulator(simulation.simulator);
+    ReleaseClock(&clock);
+    ReleaseMetricsServer(metrics);
+    CloseTrace(&trace);
     ReleaseRewindContext(context);
+    ReleaseUsageMonitor(monitor);
+    StopLog();
     return EXIT_FAILURE;
   }
 
@@ -200,90 +664,141 @@ int main(int argc, char* argv[])
     poll.type = htole32(TREE_SESSION_BY_TARGET);
     poll.flag = htole32(SESSION_TYPE_FLAG_GROUP);
 
-    printf("Waiting...\r");
-    fflush(stdout);
+    WriteLog(LOG_CATEGORY_NOTICE, "Waiting...\r");
 
+    BeginUsagePhase(monitor);
     result = WaitForRewindSessionEnd(context, &poll, interval1, interval2);
+    EndUsagePhase(monitor, USAGE_PHASE_WAIT);
 
     if (result != CLIENT_ERROR_SUCCESS)
     {
-      printf("Waiting limit exceeded (%i)\n", result);
+      WriteLog(LOG_CATEGORY_ERROR, "Waiting limit exceeded (%li)\n", (long)result);
       TransmitRewindClose(context);
-
+      FinishPreroll(&preroll);
+
+      close(record);
+      CloseInputStream(&input);
+      CloseLibrary(&library);
+      ReleaseSimulator(simulation.simulator);
+      ReleaseClock(&clock);
+      ReleaseMetricsServer(metrics);
+      CloseTrace(&trace);
       ReleaseRewindContext(context);
+      ReleaseUsageMonitor(monitor);
+      StopLog();
       return EXIT_FAILURE;
     }
   }
 
-  // Initialize timer handle
-
-  int handle;
-  struct itimerspec interval;
+  FinishPreroll(&preroll);
 
-  interval.it_interval.tv_sec  = 0;
-  interval.it_interval.tv_nsec = TDMA_FRAME_DURATION * 1000000;
+  // Transmit voice header and start frame timer with the first tick due at once,
+  // so the first audio frame follows the header without a gap
 
-  interval.it_value.tv_sec  = interval.it_interval.tv_sec;
-  interval.it_value.tv_nsec = interval.it_interval.tv_nsec;
+  WriteLog(LOG_CATEGORY_NOTICE, "Playing...\n");
 
-  handle = timerfd_create(CLOCK_MONOTONIC, 0);
-  timerfd_settime(handle, 0, &interval, NULL);
-
-  // Transmit voice header
+  header.type = htole32(SESSION_TYPE_GROUP_VOICE);
+  TransmitVoiceHeader(context, &header);
 
-  printf("Playing...\n");
+  marks[0] = GetClockTime(&clock);
+  marks[1] = 0;
 
-  header.type = htole32(SESSION_TYPE_GROUP_VOICE);
-  TransmitRewindData(context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, &header, sizeof(struct RewindSuperHeader));
-  TransmitRewindData(context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, &header, sizeof(struct RewindSuperHeader));
-  TransmitRewindData(context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, &header, sizeof(struct RewindSuperHeader));
+  StartClockTicks(&clock, TDMA_FRAME_DURATION * NANOSECONDS_PER_MILLISECOND, 0);
  
   // Main loop
 
-  uint64_t mark;
   size_t count = 0;
+  size_t limit = (duration >= 0) ? (duration / FRAMES_PER_PACKET) : SIZE_MAX;
 
-  uint8_t* pointer;
-  uint8_t* limit = buffer + 3 * size;
+  BeginUsagePhase(monitor);
 
   // Wait for timer event (60 milliseconds)
-  while (read(handle, &mark, sizeof(uint64_t)) > 0)
+  while ((ticks = WaitForClockTick(&clock)) > 0)
   {
-    pointer = buffer;
-    while ((pointer < limit) &&
-           (read(STDIN_FILENO, pointer, size) == size))
-    {
-      pointer += size;
-    }
+    // Counters are sampled by the metrics thread
+    __atomic_fetch_add(&session.ticks,  1,           __ATOMIC_RELAXED);
+    __atomic_fetch_add(&session.late,   (ticks > 1), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&session.merged, ticks - 1,   __ATOMIC_RELAXED);
 
-    if (pointer < limit)
+    if (count >= limit)
     {
-      printf("Input data stream ended\n");
+      WriteLog(LOG_CATEGORY_NOTICE, "Duration limit reached\n");
       break;
     }
 
-    printf("[> %d <]\r", count);
-    fflush(stdout);
+    // Take answers of the server and make sure it is still there
+
+    ProcessRewindData(context);
 
-    switch (size)
+    if (CheckRewindLiveness(context) != CLIENT_ERROR_SUCCESS)
     {
-      case DSD_AMBE_CHUNK_SIZE:
-        // Convert DSD to linear format
-        buffer[0 * DSD_AMBE_CHUNK_SIZE + 7] <<= 7;
-        buffer[1 * DSD_AMBE_CHUNK_SIZE + 7] <<= 7;
-        buffer[2 * DSD_AMBE_CHUNK_SIZE + 7] <<= 7;
-        memmove(buffer + 0 * LINEAR_FRAME_SIZE, buffer + 0 * DSD_AMBE_CHUNK_SIZE + 1, LINEAR_FRAME_SIZE);
-        memmove(buffer + 1 * LINEAR_FRAME_SIZE, buffer + 1 * DSD_AMBE_CHUNK_SIZE + 1, LINEAR_FRAME_SIZE);
-        memmove(buffer + 2 * LINEAR_FRAME_SIZE, buffer + 2 * DSD_AMBE_CHUNK_SIZE + 1, LINEAR_FRAME_SIZE);
-
-      case LINEAR_FRAME_SIZE:
-        TransmitRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, 3 * LINEAR_FRAME_SIZE);
+      if (attempts == 0)
+      {
+        WriteLog(LOG_CATEGORY_ERROR, "Server does not answer, playout aborted\n");
+        result = CLIENT_ERROR_RESPONSE_TIMEOUT;
         break;
+      }
 
-      case MODE33_FRAME_SIZE:
-        TransmitRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, buffer, 3 * MODE33_FRAME_SIZE);
+      WriteLog(LOG_CATEGORY_NOTICE, "Server does not answer, reconnecting...\n");
+      attempts --;
+
+      EndUsagePhase(monitor, USAGE_PHASE_PLAYBACK);
+      BeginUsagePhase(monitor);
+      result = ConnectRewindClient(context, location, port, password, 0);
+      EndUsagePhase(monitor, USAGE_PHASE_CONNECT);
+      BeginUsagePhase(monitor);
+
+      if (result < 0)
+      {
+        WriteLog(LOG_CATEGORY_ERROR, "Cannot reconnect to the server (%li)\n", (long)result);
         break;
+      }
+
+      TransmitVoiceHeader(context, &header);
+    }
+
+    if (preroll.index < preroll.count)
+    {
+      payload = preroll.data + preroll.index * FRAMES_PER_PACKET * format;
+      preroll.index ++;
     }
+    else
+    {
+      if (ReadFilteredFrames(&input, &filter, buffer, FRAMES_PER_PACKET) < FRAMES_PER_PACKET)
+      {
+        if (CheckInputStream(&input) < 0)
+        {
+          WriteLog(LOG_CATEGORY_ERROR, "Input data stream is corrupt or truncated, playout aborted\n");
+          result = INPUT_ERROR_DATA;
+          break;
+        }
+
+        WriteLog(LOG_CATEGORY_NOTICE, "Input data stream ended\n");
+        break;
+      }
+
+      payload = buffer;
+
+      if (size != format)
+      {
+        // Convert DSD to linear or transcode between linear and mode 33
+        TranscodeAMBEFrames(output, format, buffer, size, FRAMES_PER_PACKET);
+        payload = output;
+      }
+    }
+
+    WriteLog(LOG_CATEGORY_STATUS, "[> %lu <]\r", (long)count);
+
+    TransmitRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, payload, FRAMES_PER_PACKET * format);
+
+    if (session.frames == 0)
+    {
+      marks[1] = GetClockTime(&clock);
+      __atomic_store_n(&session.first, marks[1] - moment, __ATOMIC_RELAXED);
+    }
+
+    __atomic_fetch_add(&session.frames, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&session.silence, filter.dropped, __ATOMIC_RELAXED);
 
     if ((count % 83) == 0)
     {
@@ -291,18 +806,117 @@ int main(int argc, char* argv[])
       TransmitRewindKeepAlive(context);
     }
 
+    SampleRewindSendQueue(context);
+
+    if ((record >= 0) &&
+        ((count % SUPERFRAME_LENGTH) == 0))
+    {
+      // Keep position of the last transmitted frame once per superframe, pre-read frames are not sent yet
+      snprintf(text, sizeof(text), RESUME_RECORD_FORMAT, (preroll.index < preroll.count) ? preroll.positions[preroll.index - 1] : input.position);
+      pwrite(record, text, RESUME_RECORD_SIZE, 0);
+    }
+
     count ++;
   }
 
+  EndUsagePhase(monitor, USAGE_PHASE_PLAYBACK);
+
   // Transmit call terminator
   TransmitRewindData(context, REWIND_TYPE_DMR_DATA_BASE + 2, REWIND_FLAG_REAL_TIME_1, NULL, 0);
 
   // Clean up
 
-  close(handle);
   TransmitRewindClose(context);
+
+  CloseInputStream(&input);
+  CloseLibrary(&library);
+
+  if ((record >= 0) &&
+      (result == CLIENT_ERROR_SUCCESS))
+  {
+    // Playout is complete, nothing to resume
+    unlink(resume);
+  }
+
+  close(record);
+
+  WriteLog(LOG_CATEGORY_REPORT,
+    "Sent %lu packets, %lu failed (%lu congestion), %lu short\n",
+    (long)context->transmission.packets,
+    (long)context->transmission.failures,
+    (long)context->transmission.congestion,
+    (long)context->transmission.shorts);
+  WriteLog(LOG_CATEGORY_REPORT,
+    "Send queue peak %li of %li bytes, %lu retries\n",
+    (long)context->transmission.peak,
+    (long)context->transmission.buffer,
+    (long)context->transmission.retries);
+  WriteLog(LOG_CATEGORY_REPORT,
+    "Round-trip time %lu us (smoothed %lu us, variation %lu us), %lu of %lu keep-alives lost\n",
+    (long)(context->session.rtt / 1000),
+    (long)(context->session.smoothed / 1000),
+    (long)(context->session.variation / 1000),
+    (long)context->session.lost,
+    (long)context->session.keepalives);
+
+  if (context->session.polls > 0)
+    WriteLog(LOG_CATEGORY_REPORT,
+      "%lu of %lu session polls lost\n",
+      (long)context->session.expired,
+      (long)context->session.polls);
+
+  if (marks[1] != 0)
+    WriteLog(LOG_CATEGORY_REPORT,
+      "First audio frame sent %lu us after login start, %lu us after voice header (login %lu us, waiting %lu us)\n",
+      (long)((marks[1] - moment) / 1000),
+      (long)((marks[1] - marks[0]) / 1000),
+      (long)(context->session.latency / 1000),
+      (long)(context->session.waiting / 1000));
+
+  // Only whole packets are sent, so air time saved is counted by packets as check mode does
+
+  if (filter.limit > 0)
+    WriteLog(LOG_CATEGORY_REPORT,
+      "Silence compaction removed %lu of %lu frames in %lu runs, %lu ms of air time saved\n",
+      (long)filter.dropped,
+      (long)filter.frames,
+      (long)filter.runs,
+      (long)((filter.frames / FRAMES_PER_PACKET - (filter.frames - filter.dropped) / FRAMES_PER_PACKET) * FRAMES_PER_PACKET * INPUT_FRAME_DURATION));
+
+  ReportUsage(monitor, session.ticks, session.frames);
+  ReleaseUsageMonitor(monitor);
+
+  ReleaseClock(&clock);
+
+  if (simulation.simulator != NULL)
+  {
+    SynchronizeSimulation(&simulation);
+    value  = CheckSimulatorReport(simulation.simulator);
+    result = (result != 0) ? result : value;
+
+    WriteLog(LOG_CATEGORY_REPORT,
+      "Simulated %lu ms of air time: %lu headers, %lu frames, %lu terminators, %lu keep-alives\n",
+      (long)(count * TDMA_FRAME_DURATION),
+      (long)simulation.simulator->report.headers,
+      (long)simulation.simulator->report.frames,
+      (long)simulation.simulator->report.terminators,
+      (long)simulation.simulator->report.keepalives);
+    WriteLog(LOG_CATEGORY_REPORT,
+      "Sequence gaps %lu, ordering errors %lu, longest run without keep-alive %lu frames, %li problems\n",
+      (long)simulation.simulator->report.gaps,
+      (long)simulation.simulator->report.order,
+      (long)simulation.simulator->report.cadence,
+      (long)value);
+
+    ReleaseSimulator(simulation.simulator);
+  }
+
+  UnregisterMetricsSession(metrics, &session);
+  ReleaseMetricsServer(metrics);
+  CloseTrace(&trace);
   ReleaseRewindContext(context);
 
-  printf("Done\n");
-  return EXIT_SUCCESS;
+  WriteLog(LOG_CATEGORY_REPORT, "Done\n");
+  StopLog();
+  return (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 };
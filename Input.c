@@ -0,0 +1,246 @@
+#include "Input.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SKIP_BUFFER_SIZE      4096
+#define POSITION_FIELD_COUNT  3      // hh:mm:ss
+#define POSITION_FRAME_LIMIT  1e15   // Exact in a double and far below SSIZE_MAX
+
+static size_t ReadInputData(struct InputStream* stream, uint8_t* buffer, size_t length)
+{
+  size_t number = 0;
+  ssize_t count;
+
+  // Bytes consumed by format detection go first
+
+  if (stream->rest > 0)
+  {
+    number = (length < stream->rest) ? length : stream->rest;
+    memcpy(buffer, stream->prefix, number);
+    memmove(stream->prefix, stream->prefix + number, stream->rest - number);
+    stream->rest -= number;
+  }
+
+  if (stream->decompressor != NULL)
+    return number + ReadDecompressor(stream->decompressor, buffer + number, length - number);
+
+  while ((number < length) &&
+         ((count = read(stream->handle, buffer + number, length - number)) > 0))
+    number += count;
+
+  return number;
+}
+
+int OpenInputStream(struct InputStream* stream, int handle, size_t size)
+{
+  struct stat status;
+  uint8_t magic[DSD_MAGIC_SIZE];
+  int format;
+
+  memset(stream, 0, sizeof(struct InputStream));
+
+  stream->handle = handle;
+  stream->size   = size;
+  stream->count  = INPUT_UNKNOWN_COUNT;
+
+  if ((fstat(handle, &status) == 0) &&
+      (S_ISREG(status.st_mode)) &&
+      (status.st_size > 0))
+  {
+    stream->length = status.st_size;
+    stream->map    = (uint8_t*)mmap(NULL, stream->length, PROT_READ, MAP_PRIVATE, handle, 0);
+
+    if (stream->map == MAP_FAILED)
+    {
+      stream->map    = NULL;
+      stream->length = 0;
+    }
+    else
+      madvise(stream->map, stream->length, MADV_SEQUENTIAL);
+  }
+
+  // Detect compressed data before anything else
+
+  if (stream->map != NULL)
+    format = DetectCompression(stream->map, stream->length);
+  else
+  {
+    stream->rest = ReadInputData(stream, stream->prefix, COMPRESSION_MAGIC_SIZE);
+    format = DetectCompression(stream->prefix, stream->rest);
+  }
+
+  if (format != COMPRESSION_NONE)
+  {
+    // Mapping is not used for compressed data, the handle is still at its beginning
+    CloseInputStream(stream);
+    stream->decompressor = CreateDecompressor(format, handle, stream->prefix, stream->rest);
+    stream->rest = 0;
+
+    if (stream->decompressor == NULL)
+      return INPUT_ERROR_COMPRESSION;
+  }
+
+  // Check input data format if possible
+
+  if (size == DSD_AMBE_CHUNK_SIZE)
+  {
+    if ((stream->map != NULL) &&
+        ((stream->length < DSD_MAGIC_SIZE) ||
+         (memcmp(stream->map, DSD_MAGIC_TEXT, DSD_MAGIC_SIZE) != 0)) ||
+        (stream->map == NULL) &&
+        ((ReadInputData(stream, magic, DSD_MAGIC_SIZE) != DSD_MAGIC_SIZE) ||
+         (memcmp(magic, DSD_MAGIC_TEXT, DSD_MAGIC_SIZE) != 0)))
+    {
+      format = CheckInputStream(stream);
+      CloseInputStream(stream);
+      return (format < 0) ? format : INPUT_ERROR_WRONG_FORMAT;
+    }
+
+    stream->offset = DSD_MAGIC_SIZE;
+  }
+
+  if (stream->map != NULL)
+    stream->count = (stream->length - stream->offset) / size;
+
+  return INPUT_ERROR_SUCCESS;
+}
+
+void AttachInputStream(struct InputStream* stream, const uint8_t* data, size_t count, size_t size)
+{
+  memset(stream, 0, sizeof(struct InputStream));
+
+  stream->handle = -1;
+  stream->size   = size;
+  stream->count  = count;
+  stream->map    = (uint8_t*)data;
+}
+
+void CloseInputStream(struct InputStream* stream)
+{
+  if (stream->map != NULL)
+  {
+    if (stream->handle >= 0)
+      munmap(stream->map, stream->length);
+    stream->map    = NULL;
+    stream->length = 0;
+  }
+
+  ReleaseDecompressor(stream->decompressor);
+  stream->decompressor = NULL;
+}
+
+size_t ReadInputFrames(struct InputStream* stream, uint8_t* buffer, size_t count)
+{
+  if (stream->map != NULL)
+  {
+    if (count > (stream->count - stream->position))
+      count = stream->count - stream->position;
+
+    memcpy(buffer, stream->map + stream->offset + stream->position * stream->size, count * stream->size);
+    stream->position += count;
+    return count;
+  }
+
+  // Trailing partial frame is dropped
+
+  count = ReadInputData(stream, buffer, count * stream->size) / stream->size;
+  stream->position += count;
+  return count;
+}
+
+int CheckInputStream(struct InputStream* stream)
+{
+  if ((stream->decompressor != NULL) &&
+      (GetDecompressorState(stream->decompressor) < 0))
+    return INPUT_ERROR_DATA;
+
+  return INPUT_ERROR_SUCCESS;
+}
+
+int SeekInputStream(struct InputStream* stream, size_t position)
+{
+  uint8_t buffer[SKIP_BUFFER_SIZE];
+  size_t count;
+
+  if (stream->map != NULL)
+  {
+    if (position > stream->count)
+      return INPUT_ERROR_SEEK;
+
+    stream->position = position;
+    return INPUT_ERROR_SUCCESS;
+  }
+
+  // Non-seekable input can only move forward
+
+  if (position < stream->position)
+    return INPUT_ERROR_SEEK;
+
+  while (stream->position < position)
+  {
+    count = position - stream->position;
+    if (count > (SKIP_BUFFER_SIZE / stream->size))
+      count = SKIP_BUFFER_SIZE / stream->size;
+
+    if (ReadInputFrames(stream, buffer, count) < count)
+      return INPUT_ERROR_SEEK;
+  }
+
+  return INPUT_ERROR_SUCCESS;
+}
+
+ssize_t ParseInputPosition(const char* value)
+{
+  char* end;
+  double number;
+  double result;
+  int count = 1;
+
+  // Every value is checked before the conversion, out-of-range doubles cannot be cast to an integer
+
+  number = strtod(value, &end);
+
+  if ((end == value) ||
+      (!isfinite(number)) ||
+      (number < 0))
+    return -1;
+
+  if (strcmp(end, "f") == 0)
+    result = number;
+  else if (strcmp(end, "ms") == 0)
+    result = number / INPUT_FRAME_DURATION;
+  else
+  {
+    result = number;
+
+    while ((*end == ':') &&
+           (count < POSITION_FIELD_COUNT))
+    {
+      value  = end + 1;
+      number = strtod(value, &end);
+      if ((end == value) ||
+          (!isfinite(number)) ||
+          (number < 0))
+        return -1;
+      result = result * 60 + number;
+      count ++;
+    }
+
+    if ((*end != '\0') &&
+        (strcmp(end, "s") != 0))
+      return -1;
+
+    result = result * 1000 / INPUT_FRAME_DURATION;
+  }
+
+  if (result >= POSITION_FRAME_LIMIT)
+    return -1;
+
+  return (ssize_t)result;
+}
@@ -0,0 +1,72 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "Decompressor.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define DSD_MAGIC_TEXT        ".amb"
+#define DSD_MAGIC_SIZE        4
+#define DSD_AMBE_CHUNK_SIZE   8
+
+#define LINEAR_FRAME_SIZE     7
+#define MODE33_FRAME_SIZE     9
+
+#define INPUT_ERROR_SUCCESS        0
+#define INPUT_ERROR_WRONG_FORMAT  -1
+#define INPUT_ERROR_SEEK          -2
+#define INPUT_ERROR_COMPRESSION   -3
+#define INPUT_ERROR_DATA          -4  // Compressed input is corrupt, truncated or unreadable
+
+#define INPUT_FRAME_DURATION  20
+#define INPUT_UNKNOWN_COUNT   SIZE_MAX
+
+// Frames have fixed size, so position of any frame is <offset> + <frame> * <size>.
+// Regular files are mapped and seek in O(1), pipes and compressed data are skipped
+// forward by reading.
+
+struct InputStream
+{
+  int handle;
+  size_t size;      // Frame size
+  size_t offset;    // Offset of the first frame
+
+  uint8_t* map;
+  size_t length;
+
+  struct Decompressor* decompressor;
+
+  uint8_t prefix[COMPRESSION_MAGIC_SIZE];
+  size_t rest;
+
+  size_t position;  // Index of the next frame
+  size_t count;     // Total number of frames or INPUT_UNKNOWN_COUNT
+};
+
+int OpenInputStream(struct InputStream* stream, int handle, size_t size);
+
+// Reads <count> frames from memory owned by the caller, such as a library clip
+void AttachInputStream(struct InputStream* stream, const uint8_t* data, size_t count, size_t size);
+void CloseInputStream(struct InputStream* stream);
+
+size_t ReadInputFrames(struct InputStream* stream, uint8_t* buffer, size_t count);
+
+// Tells a clean end of input from a failure once ReadInputFrames returns short
+int CheckInputStream(struct InputStream* stream);
+int SeekInputStream(struct InputStream* stream, size_t position);
+
+// Parses "<n>f" as frames, "<n>ms" as milliseconds, "[[hh:]mm:]ss[.fff]" as time
+ssize_t ParseInputPosition(const char* value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,564 @@
+#include "Library.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <endian.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Checker.h"
+#include "Input.h"
+#include "AMBE.h"
+
+#define CLIP_ALIGNMENT       64
+#define MINIMAL_BUCKETS      16
+#define READ_CHUNK_SIZE      (64 * 1024)
+
+struct PackClip
+{
+  char* name;
+  uint8_t* data;
+  size_t count;
+};
+
+struct PackList
+{
+  struct PackClip* clips;
+  size_t count;
+  size_t capacity;
+  size_t input;       // Frame size of raw input files, 0 to detect
+  size_t size;        // Frame size of the library
+  int failures;
+};
+
+static uint64_t HashName(const char* name, size_t length)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  while (length > 0)
+  {
+    hash ^= (uint8_t)*name;
+    hash *= 0x100000001b3ULL;
+    name ++;
+    length --;
+  }
+
+  // Zero marks a free slot
+  return hash + (hash == 0);
+}
+
+// Reading
+
+int OpenLibrary(struct Library* library, const char* path)
+{
+  struct stat status;
+  struct LibraryHeader* header;
+  uint64_t buckets;
+  int handle;
+
+  memset(library, 0, sizeof(struct Library));
+
+  handle = open(path, O_RDONLY);
+
+  if ((handle < 0) ||
+      (fstat(handle, &status) < 0) ||
+      (status.st_size < sizeof(struct LibraryHeader)))
+  {
+    close(handle);
+    return LIBRARY_ERROR_OPEN;
+  }
+
+  library->map = (uint8_t*)mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, handle, 0);
+  close(handle);
+
+  if (library->map == MAP_FAILED)
+  {
+    library->map = NULL;
+    return LIBRARY_ERROR_OPEN;
+  }
+
+  library->length = status.st_size;
+  library->device = status.st_dev;
+  library->inode  = status.st_ino;
+
+  // Validate layout once, lookups only check bounds of the clip they return
+
+  header  = (struct LibraryHeader*)library->map;
+  buckets = le32toh(header->buckets);
+
+  if ((memcmp(header->sign, LIBRARY_SIGN_TEXT, LIBRARY_SIGN_SIZE) != 0) ||
+      (le64toh(header->length) != library->length) ||
+      (le32toh(header->size) != LINEAR_FRAME_SIZE) &&
+      (le32toh(header->size) != MODE33_FRAME_SIZE) ||
+      (buckets == 0) ||
+      (le32toh(header->count) >= buckets) ||
+      ((buckets & (buckets - 1)) != 0) ||
+      (le64toh(header->names) < (sizeof(struct LibraryHeader) + buckets * sizeof(struct LibraryEntry))) ||
+      (le64toh(header->names) > library->length) ||
+      (le64toh(header->data) < le64toh(header->names)) ||
+      (le64toh(header->data) > library->length))
+  {
+    CloseLibrary(library);
+    return LIBRARY_ERROR_FORMAT;
+  }
+
+  library->header  = header;
+  library->entries = (struct LibraryEntry*)(header + 1);
+  library->names   = (const char*)library->map + le64toh(header->names);
+
+  return LIBRARY_ERROR_SUCCESS;
+}
+
+void CloseLibrary(struct Library* library)
+{
+  if (library->map != NULL)
+  {
+    munmap(library->map, library->length);
+    memset(library, 0, sizeof(struct Library));
+  }
+}
+
+int RefreshLibrary(struct Library* library, const char* path)
+{
+  struct Library replacement;
+  struct stat status;
+
+  // Rebuilds are renamed over the old file, a new inode means a new version
+
+  if ((stat(path, &status) < 0) ||
+      (status.st_dev == library->device) &&
+      (status.st_ino == library->inode))
+    return 0;
+
+  if (OpenLibrary(&replacement, path) != LIBRARY_ERROR_SUCCESS)
+    return 0;
+
+  CloseLibrary(library);
+  memcpy(library, &replacement, sizeof(struct Library));
+  return 1;
+}
+
+const uint8_t* FindLibraryClip(struct Library* library, const char* name, size_t* count)
+{
+  struct LibraryEntry* entry;
+  uint64_t mask;
+  uint64_t hash;
+  uint64_t index;
+  uint64_t offset;
+  uint64_t limit;
+  uint64_t probe;
+  size_t length;
+  size_t size;
+
+  if (library->map == NULL)
+    return NULL;
+
+  length = strlen(name);
+  hash   = HashName(name, length);
+  mask   = le32toh(library->header->buckets) - 1;
+  limit  = le64toh(library->header->data) - le64toh(library->header->names);
+  size   = le32toh(library->header->size);
+
+  // A damaged index may have no free slot, never probe more than all of them
+
+  for (index = hash & mask, probe = 0; (probe <= mask) && ((entry = library->entries + index)->hash != 0); index = (index + 1) & mask, probe ++)
+  {
+    if ((le64toh(entry->hash) != hash) ||
+        (le32toh(entry->length) != length) ||
+        ((uint64_t)le32toh(entry->name) + length > limit) ||
+        (memcmp(library->names + le32toh(entry->name), name, length) != 0))
+      continue;
+
+    offset = le64toh(entry->offset);
+    *count = le64toh(entry->count);
+
+    if ((offset < le64toh(library->header->data)) ||
+        (offset > library->length) ||
+        (*count > (library->length - offset) / size))
+      return NULL;
+
+    return library->map + offset;
+  }
+
+  return NULL;
+}
+
+// Packing
+
+static int LoadClip(struct PackList* list, struct PackClip* clip, const char* path)
+{
+  struct InputStream stream;
+  struct CheckResult result;
+  uint8_t* data = NULL;
+  uint8_t* buffer;
+  size_t length = 0;
+  size_t count;
+  size_t offset;
+  int handle;
+
+  // Read the whole file, byte-sized frames let the input stream inflate compressed data
+
+  handle = open(path, O_RDONLY);
+
+  if ((handle < 0) ||
+      (OpenInputStream(&stream, handle, 1) != INPUT_ERROR_SUCCESS))
+  {
+    close(handle);
+    return LIBRARY_ERROR_OPEN;
+  }
+
+  do
+  {
+    buffer = (uint8_t*)realloc(data, length + READ_CHUNK_SIZE);
+    if (buffer == NULL)
+      break;
+    data    = buffer;
+    count   = ReadInputFrames(&stream, data + length, READ_CHUNK_SIZE);
+    length += count;
+  }
+  while (count == READ_CHUNK_SIZE);
+
+  CloseInputStream(&stream);
+  close(handle);
+
+  // Detect source format the same way as check mode does and convert all clips to one format
+
+  memset(&result, 0, sizeof(struct CheckResult));
+  CheckBuffer(&result, data, length, list->input);
+
+  offset = (result.size == DSD_AMBE_CHUNK_SIZE) ? DSD_MAGIC_SIZE : 0;
+
+  if (result.frames == 0)
+  {
+    free(data);
+    return LIBRARY_ERROR_FORMAT;
+  }
+
+  clip->count = result.frames;
+  clip->data  = (uint8_t*)malloc(clip->count * list->size);
+
+  if (clip->data != NULL)
+    TranscodeAMBEFrames(clip->data, list->size, data + offset, result.size, clip->count);
+
+  free(data);
+  return (clip->data != NULL) ? LIBRARY_ERROR_SUCCESS : LIBRARY_ERROR_OPEN;
+}
+
+static void AddPackPath(struct PackList* list, const char* path, size_t root)
+{
+  struct PackClip* clips;
+  struct PackClip* clip;
+  struct dirent* entry;
+  struct stat status;
+  DIR* directory;
+  char* name;
+  char* point;
+
+  if (stat(path, &status) < 0)
+  {
+    printf("%s: ERROR cannot read file\n", path);
+    list->failures ++;
+    return;
+  }
+
+  if (S_ISDIR(status.st_mode))
+  {
+    directory = opendir(path);
+
+    if (directory == NULL)
+    {
+      printf("%s: ERROR cannot read directory\n", path);
+      list->failures ++;
+      return;
+    }
+
+    while ((entry = readdir(directory)) != NULL)
+    {
+      if (entry->d_name[0] == '.')
+        continue;
+
+      name = (char*)malloc(strlen(path) + strlen(entry->d_name) + 2);
+      sprintf(name, "%s/%s", path, entry->d_name);
+      AddPackPath(list, name, (root > 0) ? root : (strlen(path) + 1));
+      free(name);
+    }
+
+    closedir(directory);
+    return;
+  }
+
+  if (!S_ISREG(status.st_mode))
+    return;
+
+  if (list->count == list->capacity)
+  {
+    list->capacity = (list->capacity > 0) ? (list->capacity * 2) : 256;
+    clips = (struct PackClip*)realloc(list->clips, list->capacity * sizeof(struct PackClip));
+    if (clips == NULL)
+    {
+      printf("%s: ERROR out of memory\n", path);
+      list->failures ++;
+      return;
+    }
+    list->clips = clips;
+  }
+
+  // Clip name is the path relative to the directory given, without extensions (.amb.gz as well)
+
+  if (root == 0)
+    root = (strrchr(path, '/') != NULL) ? (strrchr(path, '/') - path + 1) : 0;
+
+  clip = list->clips + list->count;
+  clip->name = strdup(path + root);
+
+  point = strrchr(clip->name, '/');
+  point = (point != NULL) ? (point + 1) : clip->name;
+
+  if ((point = strchr(point + 1, '.')) != NULL)
+    *point = '\0';
+
+  if (LoadClip(list, clip, path) != LIBRARY_ERROR_SUCCESS)
+  {
+    printf("%s: ERROR cannot read frames\n", path);
+    free(clip->name);
+    list->failures ++;
+    return;
+  }
+
+  list->count ++;
+}
+
+static int WriteLibrary(const char* path, struct PackList* list)
+{
+  struct LibraryHeader header;
+  struct LibraryEntry* entries;
+  struct LibraryEntry* entry;
+  struct PackClip* clip;
+  uint64_t buckets = MINIMAL_BUCKETS;
+  uint64_t offset;
+  uint64_t names;
+  uint64_t hash;
+  uint64_t index;
+  size_t number;
+  size_t length;
+  char* temporary;
+  char* pool;
+  int handle;
+  int result = LIBRARY_ERROR_SUCCESS;
+  static const uint8_t padding[CLIP_ALIGNMENT];
+
+  // Keep load factor at most one half so that probe sequences stay short
+
+  while (buckets < (list->count * 2))
+    buckets <<= 1;
+
+  entries = (struct LibraryEntry*)calloc(buckets, sizeof(struct LibraryEntry));
+  names   = 0;
+
+  for (number = 0; number < list->count; number ++)
+    names += strlen(list->clips[number].name) + 1;
+
+  pool   = (char*)malloc(names + 1);
+  names  = 0;
+
+  if ((entries == NULL) ||
+      (pool == NULL))
+  {
+    free(entries);
+    free(pool);
+    return LIBRARY_ERROR_MEMORY;
+  }
+  offset = sizeof(struct LibraryHeader) + buckets * sizeof(struct LibraryEntry);
+
+  memset(&header, 0, sizeof(struct LibraryHeader));
+  memcpy(header.sign, LIBRARY_SIGN_TEXT, LIBRARY_SIGN_SIZE);
+  header.size    = htole32(list->size);
+  header.count   = htole32(list->count);
+  header.buckets = htole32(buckets);
+  header.names   = htole64(offset);
+
+  for (number = 0; number < list->count; number ++)
+  {
+    clip   = list->clips + number;
+    length = strlen(clip->name);
+    memcpy(pool + names, clip->name, length + 1);
+    names += length + 1;
+  }
+
+  offset += names;
+  offset  = (offset + CLIP_ALIGNMENT - 1) & ~(uint64_t)(CLIP_ALIGNMENT - 1);
+  header.data = htole64(offset);
+
+  for (number = 0, names = 0; (number < list->count) && (result == LIBRARY_ERROR_SUCCESS); number ++)
+  {
+    clip   = list->clips + number;
+    length = strlen(clip->name);
+    hash   = HashName(clip->name, length);
+
+    for (index = hash & (buckets - 1); entries[index].hash != 0; index = (index + 1) & (buckets - 1))
+      if ((entries[index].hash == htole64(hash)) &&
+          (strcmp(pool + le32toh(entries[index].name), clip->name) == 0))
+      {
+        printf("%s: ERROR duplicate clip name\n", clip->name);
+        result = LIBRARY_ERROR_FORMAT;
+        break;
+      }
+
+    if (result != LIBRARY_ERROR_SUCCESS)
+      break;
+
+    entry = entries + index;
+    entry->hash   = htole64(hash);
+    entry->name   = htole32(names);
+    entry->length = htole32(length);
+    entry->offset = htole64(offset);
+    entry->count  = htole64(clip->count);
+
+    names  += length + 1;
+    offset += clip->count * list->size;
+    offset  = (offset + CLIP_ALIGNMENT - 1) & ~(uint64_t)(CLIP_ALIGNMENT - 1);
+  }
+
+  header.length = htole64(offset);
+
+  // Write next to the target and rename, processes that have the old file mapped keep using it
+
+  temporary = (char*)malloc(strlen(path) + 32);
+
+  if ((result != LIBRARY_ERROR_SUCCESS) ||
+      (temporary == NULL))
+  {
+    free(temporary);
+    free(entries);
+    free(pool);
+    return (result != LIBRARY_ERROR_SUCCESS) ? result : LIBRARY_ERROR_MEMORY;
+  }
+
+  sprintf(temporary, "%s.%d.tmp", path, getpid());
+
+  handle = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if ((handle < 0) ||
+      (write(handle, &header, sizeof(struct LibraryHeader)) != sizeof(struct LibraryHeader)) ||
+      (write(handle, entries, buckets * sizeof(struct LibraryEntry)) != (buckets * sizeof(struct LibraryEntry))) ||
+      (write(handle, pool, names) != names))
+    result = LIBRARY_ERROR_WRITE;
+
+  offset = sizeof(struct LibraryHeader) + buckets * sizeof(struct LibraryEntry) + names;
+
+  for (number = 0; (number <= list->count) && (result == LIBRARY_ERROR_SUCCESS); number ++)
+  {
+    length = (CLIP_ALIGNMENT - offset % CLIP_ALIGNMENT) % CLIP_ALIGNMENT;
+
+    if (write(handle, padding, length) != length)
+      result = LIBRARY_ERROR_WRITE;
+
+    offset += length;
+
+    if (number == list->count)
+      break;
+
+    clip   = list->clips + number;
+    length = clip->count * list->size;
+
+    if (write(handle, clip->data, length) != length)
+      result = LIBRARY_ERROR_WRITE;
+
+    offset += length;
+  }
+
+  if ((result == LIBRARY_ERROR_SUCCESS) &&
+      ((fsync(handle) < 0) ||
+       (rename(temporary, path) < 0)))
+    result = LIBRARY_ERROR_WRITE;
+
+  if (result != LIBRARY_ERROR_SUCCESS)
+    unlink(temporary);
+
+  close(handle);
+  free(temporary);
+  free(entries);
+  free(pool);
+  return result;
+}
+
+int RunLibraryPack(int argc, char* argv[])
+{
+  struct PackList list;
+  size_t frames = 0;
+  size_t index;
+  int selection;
+  int result;
+  int invalid = 0;
+
+  struct option options[] =
+  {
+    { "linear",  no_argument,       NULL, 'l' },
+    { "mode33",  no_argument,       NULL, 'm' },
+    { "output",  required_argument, NULL, 'o' },
+    { NULL,      0,                 NULL, 0   }
+  };
+
+  memset(&list, 0, sizeof(struct PackList));
+  list.size = LINEAR_FRAME_SIZE;
+
+  while ((selection = getopt_long(argc, argv, "lmo:", options, NULL)) != EOF)
+    switch (selection)
+    {
+      case 'l':
+        list.input = LINEAR_FRAME_SIZE;
+        break;
+
+      case 'm':
+        list.input = MODE33_FRAME_SIZE;
+        break;
+
+      case 'o':
+        list.size = (strcmp(optarg, "linear") == 0) ? LINEAR_FRAME_SIZE : (strcmp(optarg, "mode33") == 0) ? MODE33_FRAME_SIZE : 0;
+        invalid  |= (list.size == 0);
+        break;
+    }
+
+  if (((optind + 1) >= argc) ||
+      (invalid != 0))
+  {
+    printf(
+      "Usage:\n"
+      "  digestplay pack [--linear | --mode33] [--output linear | mode33] <library> <file or directory>...\n"
+      "\n");
+    return EXIT_FAILURE;
+  }
+
+  for (index = optind + 1; index < argc; index ++)
+    AddPackPath(&list, argv[index], 0);
+
+  result = LIBRARY_ERROR_FORMAT;
+
+  if (list.failures == 0)
+    result = WriteLibrary(argv[optind], &list);
+
+  for (index = 0; index < list.count; index ++)
+  {
+    frames += list.clips[index].count;
+    free(list.clips[index].name);
+    free(list.clips[index].data);
+  }
+
+  free(list.clips);
+
+  if (result != LIBRARY_ERROR_SUCCESS)
+  {
+    printf("Library %s is not written (%i)\n", argv[optind], result);
+    return EXIT_FAILURE;
+  }
+
+  printf("Packed %zu clips of %zu frames into %s\n", list.count, frames, argv[optind]);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LIBRARY_SIGN_TEXT  "DPLIB001"
+#define LIBRARY_SIGN_SIZE  8
+
+#define LIBRARY_ERROR_SUCCESS      0
+#define LIBRARY_ERROR_OPEN        -1
+#define LIBRARY_ERROR_FORMAT      -2
+#define LIBRARY_ERROR_WRITE       -3
+#define LIBRARY_ERROR_NOT_FOUND   -4
+#define LIBRARY_ERROR_MEMORY      -5
+
+// Packed library file, all values are little-endian:
+//   header, index of <buckets> slots, name pool, frame data (64-byte aligned clips)
+// Index uses open addressing with linear probing on FNV-1a hash, hash 0 marks a free slot
+
+struct LibraryHeader
+{
+  char sign[LIBRARY_SIGN_SIZE];
+  uint32_t size;      // Frame size of all clips (LINEAR_FRAME_SIZE or MODE33_FRAME_SIZE)
+  uint32_t count;     // Number of clips
+  uint32_t buckets;   // Number of index slots, power of two
+  uint32_t reserved;
+  uint64_t names;     // Offset of name pool
+  uint64_t data;      // Offset of frame data
+  uint64_t length;    // Total file length
+};
+
+struct LibraryEntry
+{
+  uint64_t hash;
+  uint32_t name;      // Offset of name in name pool
+  uint32_t length;    // Length of name
+  uint64_t offset;    // Offset of the first frame in file
+  uint64_t count;     // Number of frames
+};
+
+// Read-only shared mapping, all processes that open the same file share its pages.
+// Rebuilds replace the file by rename, mappings in use keep the previous version.
+
+struct Library
+{
+  uint8_t* map;
+  size_t length;
+  dev_t device;
+  ino_t inode;
+
+  struct LibraryHeader* header;
+  struct LibraryEntry* entries;
+  const char* names;
+};
+
+int OpenLibrary(struct Library* library, const char* path);
+void CloseLibrary(struct Library* library);
+
+// Maps the file at <path> again if pack replaced it, returns 1 when reloaded.
+// Clip pointers taken before a reload are no longer valid.
+int RefreshLibrary(struct Library* library, const char* path);
+
+// Returns pointer to the first frame of clip or NULL, <count> receives number of frames
+const uint8_t* FindLibraryClip(struct Library* library, const char* name, size_t* count);
+
+// Entry point of "digestplay pack [--linear|--mode33] [--output linear|mode33] <library> <file or directory>...",
+// --linear and --mode33 tell the format of raw input files as in check mode, --output the format of the library
+int RunLibraryPack(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+#include "Log.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/eventfd.h>
+
+#define NANOSECONDS_PER_SECOND  1000000000ULL
+
+#define LOG_RING_MASK           (LOG_RING_SIZE - 1)
+
+struct LogRecord
+{
+  uint64_t sequence;
+  uint32_t category;
+  const char* format;
+  long arguments[LOG_ARGUMENT_COUNT];
+};
+
+struct LogLimit
+{
+  uint64_t interval;  // Nanoseconds between records at the sustained rate
+  uint64_t tolerance; // Burst allowance in nanoseconds
+  uint64_t arrival;   // Theoretical arrival time of the next record
+  uint64_t dropped;
+};
+
+static struct LogRecord ring[LOG_RING_SIZE];
+static uint64_t head = 0;
+static uint64_t tail = 0;
+
+static struct LogLimit limits[LOG_CATEGORY_COUNT] =
+{
+  { NANOSECONDS_PER_SECOND / 4,  NANOSECONDS_PER_SECOND / 4 * 1,  0, 0 },  // LOG_CATEGORY_STATUS
+  { NANOSECONDS_PER_SECOND / 50, NANOSECONDS_PER_SECOND / 50 * 10, 0, 0 }, // LOG_CATEGORY_NOTICE
+  { NANOSECONDS_PER_SECOND / 50, NANOSECONDS_PER_SECOND / 50 * 10, 0, 0 }, // LOG_CATEGORY_ERROR
+  { 0,                           0,                                 0, 0 }  // LOG_CATEGORY_REPORT
+};
+
+static volatile int state = 0;
+static pthread_t consumer;
+
+// Consumer blocks on the eventfd while the ring is empty, producers only
+// signal it when they find the consumer asleep
+
+static int event = -1;
+static int sleeping = 0;
+
+static uint64_t GetMonotonicTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+static int CheckLogLimit(struct LogLimit* limit)
+{
+  uint64_t now = GetMonotonicTime();
+  uint64_t arrival;
+  uint64_t value;
+
+  if (limit->interval == 0)
+    return 1;
+
+  // Generic cell rate algorithm, lock-free across producers
+
+  arrival = __atomic_load_n(&limit->arrival, __ATOMIC_RELAXED);
+  do
+  {
+    value = (arrival > now) ? arrival : now;
+    if ((value - now) > limit->tolerance)
+    {
+      __atomic_add_fetch(&limit->dropped, 1, __ATOMIC_RELAXED);
+      return 0;
+    }
+  }
+  while (!__atomic_compare_exchange_n(&limit->arrival, &arrival, value + limit->interval, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  return 1;
+}
+
+static int FlushLog()
+{
+  struct LogRecord* record;
+  uint64_t sequence;
+  uint64_t dropped;
+  uint32_t category;
+  int count = 0;
+
+  while (1)
+  {
+    record = ring + (head & LOG_RING_MASK);
+    sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+
+    if (sequence != (head + 1))
+      break;
+
+    printf(record->format,
+      record->arguments[0],
+      record->arguments[1],
+      record->arguments[2],
+      record->arguments[3],
+      record->arguments[4],
+      record->arguments[5]);
+
+    __atomic_store_n(&record->sequence, head + LOG_RING_SIZE, __ATOMIC_RELEASE);
+    head ++;
+    count ++;
+  }
+
+  for (category = LOG_CATEGORY_NOTICE; category < LOG_CATEGORY_COUNT; category ++)
+  {
+    // Status lines are overwritten anyway, report suppression for the rest only
+    dropped = __atomic_exchange_n(&limits[category].dropped, 0, __ATOMIC_RELAXED);
+    if (dropped > 0)
+    {
+      printf("(%lu messages suppressed)\n", (unsigned long)dropped);
+      count ++;
+    }
+  }
+
+  if (count > 0)
+    fflush(stdout);
+
+  return count;
+}
+
+static int CheckLogRing()
+{
+  return __atomic_load_n(&ring[head & LOG_RING_MASK].sequence, __ATOMIC_ACQUIRE) == (head + 1);
+}
+
+static void* ConsumeLog(void* argument)
+{
+  uint64_t value;
+
+  while (state != 0)
+  {
+    if (FlushLog() > 0)
+      continue;
+
+    __atomic_store_n(&sleeping, 1, __ATOMIC_SEQ_CST);
+
+    if ((state != 0) &&
+        (CheckLogRing() == 0))
+      read(event, &value, sizeof(uint64_t));
+
+    __atomic_store_n(&sleeping, 0, __ATOMIC_SEQ_CST);
+  }
+
+  FlushLog();
+  return NULL;
+}
+
+static void WakeLog()
+{
+  uint64_t value = 1;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (__atomic_exchange_n(&sleeping, 0, __ATOMIC_SEQ_CST) != 0)
+    write(event, &value, sizeof(uint64_t));
+}
+
+int StartLog()
+{
+  uint64_t index;
+
+  for (index = 0; index < LOG_RING_SIZE; index ++)
+    ring[index].sequence = index;
+
+  head     = 0;
+  tail     = 0;
+  sleeping = 0;
+  event    = eventfd(0, 0);
+
+  if (event < 0)
+    return -1;
+
+  state = 1;
+
+  if (pthread_create(&consumer, NULL, ConsumeLog, NULL) != 0)
+  {
+    state = 0;
+    close(event);
+    event = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+void StopLog()
+{
+  uint64_t value = 1;
+
+  if (state != 0)
+  {
+    state = 0;
+    write(event, &value, sizeof(uint64_t));
+    pthread_join(consumer, NULL);
+    close(event);
+    event = -1;
+  }
+}
+
+void SetLogRate(uint32_t category, uint32_t rate, uint32_t burst)
+{
+  if ((category < LOG_CATEGORY_REPORT) &&
+      (rate > 0))
+  {
+    limits[category].interval  = NANOSECONDS_PER_SECOND / rate;
+    limits[category].tolerance = limits[category].interval * burst;
+  }
+}
+
+void WriteLog(uint32_t category, const char* format, ...)
+{
+  struct LogRecord* record;
+  uint64_t position;
+  uint64_t sequence;
+  int64_t difference;
+  va_list arguments;
+  const char* pointer;
+  size_t count = 0;
+
+  if ((category >= LOG_CATEGORY_COUNT) ||
+      (CheckLogLimit(limits + category) == 0))
+    return;
+
+  // Bounded multi-producer queue, a full ring drops the record instead of waiting
+
+  position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+  while (1)
+  {
+    record = ring + (position & LOG_RING_MASK);
+    sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+    difference = (int64_t)(sequence - position);
+
+    if ((difference == 0) &&
+        (__atomic_compare_exchange_n(&tail, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)))
+      break;
+
+    if (difference < 0)
+    {
+      __atomic_add_fetch(&limits[category].dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+
+    if (difference > 0)
+      position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+  }
+
+  record->category = category;
+  record->format   = format;
+  memset(record->arguments, 0, sizeof(record->arguments));
+
+  va_start(arguments, format);
+  for (pointer = strchr(format, '%'); (pointer != NULL) && (count < LOG_ARGUMENT_COUNT); pointer = strchr(pointer + 1, '%'))
+  {
+    if (pointer[1] == '%')
+    {
+      pointer ++;
+      continue;
+    }
+    record->arguments[count ++] = va_arg(arguments, long);
+  }
+  va_end(arguments);
+
+  __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+  WakeLog();
+}
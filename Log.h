@@ -0,0 +1,33 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define LOG_CATEGORY_STATUS    0
+#define LOG_CATEGORY_NOTICE    1
+#define LOG_CATEGORY_ERROR     2
+#define LOG_CATEGORY_REPORT    3  // End-of-run summary, never rate-limited
+#define LOG_CATEGORY_COUNT     4
+
+#define LOG_RING_SIZE          1024
+#define LOG_ARGUMENT_COUNT     6
+
+// Records are fixed-size: the format must be a string literal and every
+// argument is passed as long, so use %ld / %li / %lu in the format
+
+int StartLog();
+void StopLog();
+
+void SetLogRate(uint32_t category, uint32_t rate, uint32_t burst);
+void WriteLog(uint32_t category, const char* format, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
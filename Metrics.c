@@ -0,0 +1,378 @@
+#include "Metrics.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <poll.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#define ACCEPT_TIMEOUT     200
+#define REQUEST_SIZE       1024
+#define LISTEN_BACKLOG     8
+
+#define UNIX_PREFIX        "unix:"
+#define UNIX_PREFIX_SIZE   5
+
+#define EOF_TEXT           "# EOF\n"
+#define SAMPLE_LINE_SIZE   128
+
+struct MetricsFamily
+{
+  const char* name;
+  const char* type;
+  const char* help;
+};
+
+static const struct MetricsFamily families[] =
+{
+  { "digestplay_frames_sent",                 "counter", "Audio packets of three AMBE frames transmitted"        },
+  { "digestplay_ticks",                       "counter", "Timer events processed by the pacing loop"             },
+  { "digestplay_ticks_late",                  "counter", "Timer events that covered more than one tick"          },
+  { "digestplay_ticks_merged",                "counter", "Ticks folded into late timer events"                   },
+  { "digestplay_first_frame_seconds",         "gauge",   "Time from login start to the first audio frame"        },
+  { "digestplay_silence_removed_frames",      "counter", "Silence frames removed by --max-silence"               },
+  { "digestplay_keepalives_sent",             "counter", "Keep-alive packets sent"                               },
+  { "digestplay_keepalives_answered",         "counter", "Keep-alive answers received"                           },
+  { "digestplay_login_attempts",              "counter", "Authentication attempts"                               },
+  { "digestplay_login_latency_seconds",       "gauge",   "Duration of the last successful login"                 },
+  { "digestplay_wait_seconds",                "counter", "Time spent waiting for the end of a talkgroup session" },
+  { "digestplay_round_trip_seconds",          "gauge",   "Last round-trip time of a keep-alive or session poll"  },
+  { "digestplay_round_trip_smoothed_seconds", "gauge",   "Smoothed round-trip time"                              },
+  { "digestplay_keepalives_lost",             "counter", "Keep-alives not answered in time"                      },
+  { "digestplay_session_polls",               "counter", "Session polls sent while waiting for a quiet TG"       },
+  { "digestplay_session_polls_lost",          "counter", "Session polls not answered in time"                    },
+  { "digestplay_packets_sent",                "counter", "Packets accepted by the kernel"                        },
+  { "digestplay_send_errors",                 "counter", "Packets refused by the kernel"                         },
+  { "digestplay_send_congestion",             "counter", "Packets refused with ENOBUFS or EAGAIN"                },
+  { "digestplay_send_short",                  "counter", "Packets accepted partially"                            },
+  { "digestplay_send_queue_bytes",            "gauge",   "Last sampled socket send queue depth"                  },
+  { "digestplay_sequence_control",            "gauge",   "Current sequence number of control packets"            },
+  { "digestplay_sequence_real_time",          "gauge",   "Current sequence number of real-time packets"          }
+};
+
+#define FAMILY_COUNT  (sizeof(families) / sizeof(families[0]))
+
+static void GetMetricsValues(struct MetricsSession* session, double* values)
+{
+  struct RewindContext* context = session->context;
+
+  values[0]  = __atomic_load_n(&session->frames, __ATOMIC_RELAXED);
+  values[1]  = __atomic_load_n(&session->ticks,  __ATOMIC_RELAXED);
+  values[2]  = __atomic_load_n(&session->late,   __ATOMIC_RELAXED);
+  values[3]  = __atomic_load_n(&session->merged, __ATOMIC_RELAXED);
+  values[4]  = __atomic_load_n(&session->first,  __ATOMIC_RELAXED) / (double)NANOSECONDS_PER_SECOND;
+  values[5]  = __atomic_load_n(&session->silence, __ATOMIC_RELAXED);
+  values[6]  = __atomic_load_n(&context->session.keepalives, __ATOMIC_RELAXED);
+  values[7]  = __atomic_load_n(&context->session.answers,    __ATOMIC_RELAXED);
+  values[8]  = __atomic_load_n(&context->session.logins,     __ATOMIC_RELAXED);
+  values[9]  = __atomic_load_n(&context->session.latency,    __ATOMIC_RELAXED) / (double)NANOSECONDS_PER_SECOND;
+  values[10] = __atomic_load_n(&context->session.waiting,    __ATOMIC_RELAXED) / (double)NANOSECONDS_PER_SECOND;
+  values[11] = __atomic_load_n(&context->session.rtt,      __ATOMIC_RELAXED) / (double)NANOSECONDS_PER_SECOND;
+  values[12] = __atomic_load_n(&context->session.smoothed, __ATOMIC_RELAXED) / (double)NANOSECONDS_PER_SECOND;
+  values[13] = __atomic_load_n(&context->session.lost,     __ATOMIC_RELAXED);
+  values[14] = __atomic_load_n(&context->session.polls,    __ATOMIC_RELAXED);
+  values[15] = __atomic_load_n(&context->session.expired,  __ATOMIC_RELAXED);
+  values[16] = __atomic_load_n(&context->transmission.packets,    __ATOMIC_RELAXED);
+  values[17] = __atomic_load_n(&context->transmission.failures,   __ATOMIC_RELAXED);
+  values[18] = __atomic_load_n(&context->transmission.congestion, __ATOMIC_RELAXED);
+  values[19] = __atomic_load_n(&context->transmission.shorts,     __ATOMIC_RELAXED);
+  values[20] = __atomic_load_n(&context->transmission.queue,      __ATOMIC_RELAXED);
+  values[21] = __atomic_load_n(&context->counters[0], __ATOMIC_RELAXED);
+  values[22] = __atomic_load_n(&context->counters[1], __ATOMIC_RELAXED);
+}
+
+size_t FormatMetrics(struct MetricsServer* server, char* buffer, size_t length)
+{
+  struct MetricsSession* session;
+  double* values;
+  size_t offset = 0;
+  size_t start;
+  size_t limit;
+  size_t count = 0;
+  size_t index;
+  size_t number;
+
+  if (length < sizeof(EOF_TEXT))
+    return 0;
+
+  // Families that do not fit are left out as a whole, the exposition always ends with # EOF
+
+  limit = length - sizeof(EOF_TEXT) + 1;
+
+  pthread_mutex_lock(&server->lock);
+
+  // Sample every session once so all families of a scrape come from the same snapshot
+
+  for (session = server->sessions; session != NULL; session = session->next)
+    count ++;
+
+  values = (double*)malloc((count + 1) * FAMILY_COUNT * sizeof(double));
+
+  for (session = server->sessions, number = 0; (session != NULL) && (values != NULL); session = session->next, number ++)
+    GetMetricsValues(session, values + number * FAMILY_COUNT);
+
+  for (index = 0; (index < FAMILY_COUNT) && (values != NULL); index ++)
+  {
+    start   = offset;
+    offset += snprintf(buffer + offset, limit - offset,
+      "# HELP %s %s\n"
+      "# TYPE %s %s\n",
+      families[index].name, families[index].help,
+      families[index].name, families[index].type);
+
+    for (session = server->sessions, number = 0; (session != NULL) && (offset < limit); session = session->next, number ++)
+    {
+      offset += snprintf(buffer + offset, limit - offset,
+        "%s%s{group=\"%u\",source=\"%u\"} %.9g\n",
+        families[index].name,
+        (families[index].type[0] == 'c') ? "_total" : "",
+        session->group,
+        session->source,
+        values[number * FAMILY_COUNT + index]);
+    }
+
+    if (offset >= limit)
+    {
+      offset = start;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&server->lock);
+  free(values);
+
+  memcpy(buffer + offset, EOF_TEXT, sizeof(EOF_TEXT) - 1);
+  return offset + sizeof(EOF_TEXT) - 1;
+}
+
+static void* ExecuteMetricsServer(void* argument)
+{
+  struct MetricsServer* server = (struct MetricsServer*)argument;
+  struct pollfd events[METRICS_HANDLE_COUNT];
+  char* buffer = (char*)malloc(METRICS_BUFFER_SIZE);
+  char* larger;
+  char request[REQUEST_SIZE];
+  char header[256];
+  size_t capacity = METRICS_BUFFER_SIZE;
+  size_t length;
+  size_t index;
+  int handle;
+
+  for (index = 0; index < server->count; index ++)
+  {
+    events[index].fd     = server->handles[index];
+    events[index].events = POLLIN;
+  }
+
+  while ((server->state != 0) &&
+         (buffer != NULL))
+  {
+    if (poll(events, server->count, ACCEPT_TIMEOUT) <= 0)
+      continue;
+
+    for (index = 0; (index < server->count) && ((events[index].revents & POLLIN) == 0); index ++);
+
+    if ((index == server->count) ||
+        ((handle = accept(server->handles[index], NULL, NULL)) < 0))
+      continue;
+
+    // Any request gets the full exposition, one request per connection
+
+    recv(handle, request, REQUEST_SIZE, MSG_DONTWAIT);
+
+    // Leave room for one sample line per family and session
+
+    length = METRICS_BUFFER_SIZE + __atomic_load_n(&server->registered, __ATOMIC_RELAXED) * FAMILY_COUNT * SAMPLE_LINE_SIZE;
+
+    if ((length > capacity) &&
+        ((larger = (char*)realloc(buffer, length)) != NULL))
+    {
+      buffer   = larger;
+      capacity = length;
+    }
+
+    length = FormatMetrics(server, buffer, capacity);
+
+    snprintf(header, sizeof(header),
+      "HTTP/1.0 200 OK\r\n"
+      "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+      "Content-Length: %zu\r\n"
+      "Connection: close\r\n"
+      "\r\n",
+      length);
+
+    send(handle, header, strlen(header), MSG_NOSIGNAL);
+    send(handle, buffer, length, MSG_NOSIGNAL);
+    close(handle);
+  }
+
+  free(buffer);
+  return NULL;
+}
+
+static void CloseMetricsHandles(struct MetricsServer* server)
+{
+  size_t index;
+
+  for (index = 0; index < server->count; index ++)
+    close(server->handles[index]);
+
+  server->count = 0;
+}
+
+struct MetricsServer* CreateMetricsServer(const char* address)
+{
+  struct MetricsServer* server;
+  struct sockaddr_un name;
+  struct addrinfo hints;
+  struct addrinfo* list = NULL;
+  struct addrinfo* entry;
+  const char* port;
+  char* host = NULL;
+  int handle;
+  int value = 1;
+
+  server = (struct MetricsServer*)calloc(1, sizeof(struct MetricsServer));
+
+  if (server == NULL)
+    return NULL;
+
+  if (strncmp(address, UNIX_PREFIX, UNIX_PREFIX_SIZE) == 0)
+  {
+    memset(&name, 0, sizeof(struct sockaddr_un));
+    name.sun_family = AF_UNIX;
+    strncpy(name.sun_path, address + UNIX_PREFIX_SIZE, sizeof(name.sun_path) - 1);
+
+    server->path = strdup(name.sun_path);
+    handle       = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    unlink(server->path);
+
+    if ((handle >= 0) &&
+        ((bind(handle, (struct sockaddr*)&name, sizeof(struct sockaddr_un)) < 0) ||
+         (listen(handle, LISTEN_BACKLOG) < 0)))
+    {
+      close(handle);
+      handle = -1;
+    }
+
+    if (handle >= 0)
+      server->handles[server->count ++] = handle;
+  }
+  else
+  {
+    // Listen on loopback unless host is given explicitly, every resolved address
+    // gets its own socket so both 127.0.0.1 and ::1 are reachable
+
+    port = strrchr(address, ':');
+
+    if (port != NULL)
+    {
+      host = strndup(address, port - address);
+      port ++;
+    }
+    else
+      port = address;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_family   = AF_UNSPEC;
+
+    if (getaddrinfo(host, port, &hints, &list) == 0)
+    {
+      for (entry = list; (entry != NULL) && (server->count < METRICS_HANDLE_COUNT); entry = entry->ai_next)
+      {
+        handle = socket(entry->ai_family, SOCK_STREAM, 0);
+
+        if (handle < 0)
+          continue;
+
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(int));
+
+        if (entry->ai_family == AF_INET6)
+          setsockopt(handle, IPPROTO_IPV6, IPV6_V6ONLY, &value, sizeof(int));
+
+        if ((bind(handle, entry->ai_addr, entry->ai_addrlen) < 0) ||
+            (listen(handle, LISTEN_BACKLOG) < 0))
+        {
+          close(handle);
+          continue;
+        }
+
+        server->handles[server->count ++] = handle;
+      }
+
+      freeaddrinfo(list);
+    }
+
+    free(host);
+  }
+
+  pthread_mutex_init(&server->lock, NULL);
+  server->state = 1;
+
+  if ((server->count == 0) ||
+      (pthread_create(&server->thread, NULL, ExecuteMetricsServer, server) != 0))
+  {
+    CloseMetricsHandles(server);
+    pthread_mutex_destroy(&server->lock);
+    free(server->path);
+    free(server);
+    return NULL;
+  }
+
+  return server;
+}
+
+void ReleaseMetricsServer(struct MetricsServer* server)
+{
+  if (server != NULL)
+  {
+    server->state = 0;
+    pthread_join(server->thread, NULL);
+    CloseMetricsHandles(server);
+
+    if (server->path != NULL)
+      unlink(server->path);
+
+    pthread_mutex_destroy(&server->lock);
+    free(server->path);
+    free(server);
+  }
+}
+
+void RegisterMetricsSession(struct MetricsServer* server, struct MetricsSession* session)
+{
+  if (server != NULL)
+  {
+    pthread_mutex_lock(&server->lock);
+    session->next    = server->sessions;
+    server->sessions = session;
+    __atomic_store_n(&server->registered, server->registered + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&server->lock);
+  }
+}
+
+void UnregisterMetricsSession(struct MetricsServer* server, struct MetricsSession* session)
+{
+  struct MetricsSession** link;
+
+  if (server != NULL)
+  {
+    pthread_mutex_lock(&server->lock);
+    for (link = &server->sessions; *link != NULL; link = &(*link)->next)
+      if (*link == session)
+      {
+        *link = session->next;
+        __atomic_store_n(&server->registered, server->registered - 1, __ATOMIC_RELAXED);
+        break;
+      }
+    pthread_mutex_unlock(&server->lock);
+  }
+}
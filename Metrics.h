@@ -0,0 +1,67 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "RewindClient.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define METRICS_BUFFER_SIZE  16384
+#define METRICS_HANDLE_COUNT 4
+
+// Playback counters maintained by the pacing loop
+
+struct MetricsSession
+{
+  struct MetricsSession* next;
+  struct RewindContext* context;
+
+  uint32_t group;
+  uint32_t source;
+
+  uint64_t frames;  // Audio packets transmitted
+  uint64_t ticks;   // Timer events processed
+  uint64_t late;    // Timer events that covered more than one tick
+  uint64_t merged;  // Ticks folded into late events
+  uint64_t first;   // Time from login start to the first audio frame in nanoseconds
+  uint64_t silence; // Silence frames removed by compaction
+};
+
+// OpenMetrics text endpoint served by its own thread, values are sampled
+// without locking the pacing loop, all counters are word-sized
+
+struct MetricsServer
+{
+  int handles[METRICS_HANDLE_COUNT];
+  size_t count;
+  char* path;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  volatile int state;
+
+  struct MetricsSession* sessions;
+  size_t registered;      // Number of sessions, sizes the exposition buffer
+};
+
+// <address> is "[host:]port" for HTTP over TCP or "unix:<path>" for a UNIX socket,
+// the server listens on every address the host resolves to, both loopback
+// addresses when no host is given
+struct MetricsServer* CreateMetricsServer(const char* address);
+void ReleaseMetricsServer(struct MetricsServer* server);
+
+void RegisterMetricsSession(struct MetricsServer* server, struct MetricsSession* session);
+void UnregisterMetricsSession(struct MetricsServer* server, struct MetricsSession* session);
+
+size_t FormatMetrics(struct MetricsServer* server, char* buffer, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
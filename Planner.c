@@ -0,0 +1,638 @@
+#include "Planner.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "Player.h"
+#include "Scheduler.h"
+
+static struct PlannerGroup* FindPlannerGroup(struct Planner* planner, uint32_t group)
+{
+  size_t index;
+
+  for (index = 0; index < planner->count; index ++)
+    if (planner->groups[index].group == group)
+      return planner->groups + index;
+
+  return NULL;
+}
+
+static void ReleasePlannerGroup(struct Planner* planner, struct PlannerGroup* group)
+{
+  group->jobs --;
+
+  if (group->jobs == 0)
+  {
+    // Nobody waits for the TG anymore, stop polling it
+    CloseSession(planner->table, group->session);
+    planner->count --;
+    *group = planner->groups[planner->count];
+  }
+}
+
+void InitializePlanner(struct Planner* planner, struct SessionTable* table, uint32_t number, int address, size_t limit)
+{
+  memset(planner, 0, sizeof(struct Planner));
+
+  planner->table   = table;
+  planner->number  = number;
+  planner->address = address;
+  planner->limit   = limit;
+}
+
+void ReleasePlanner(struct Planner* planner)
+{
+  size_t index;
+
+  for (index = 0; index < planner->count; index ++)
+    CloseSession(planner->table, planner->groups[index].session);
+
+  planner->count = 0;
+  planner->jobs  = NULL;
+}
+
+int SubmitPlannerJob(struct Planner* planner, struct PlannerJob* job, uint64_t now)
+{
+  struct PlannerGroup* group;
+  struct PlannerJob** link;
+  ssize_t session;
+
+  job->state     = PLANNER_JOB_PENDING;
+  job->submitted = now;
+  job->started   = 0;
+
+  planner->statistics.submitted ++;
+
+  if (job->deadline < now)
+  {
+    job->state   = PLANNER_JOB_EXPIRED;
+    job->started = now;
+    planner->statistics.expired ++;
+    return PLANNER_ERROR_EXPIRED;
+  }
+
+  group = FindPlannerGroup(planner, job->group);
+
+  if (group == NULL)
+  {
+    // First job of the TG opens a session that polls it with every keep-alive
+
+    if ((planner->count == PLANNER_GROUP_COUNT) ||
+        ((session = OpenSession(planner->table, planner->number, planner->address, now)) < 0))
+    {
+      job->state = PLANNER_JOB_FAILED;
+      return PLANNER_ERROR_SESSION;
+    }
+
+    PollSessionGroup(planner->table, session, job->group);
+
+    group = planner->groups + planner->count;
+    memset(group, 0, sizeof(struct PlannerGroup));
+    group->group   = job->group;
+    group->session = session;
+    planner->count ++;
+  }
+
+  group->jobs ++;
+
+  // Keep pending jobs ordered by deadline, higher priority first on a tie
+
+  for (link = &planner->jobs;
+       (*link != NULL) &&
+       (((*link)->deadline < job->deadline) ||
+        ((*link)->deadline == job->deadline) &&
+        ((*link)->priority >= job->priority));
+       link = &(*link)->next);
+
+  job->next = *link;
+  *link     = job;
+
+  return PLANNER_ERROR_SUCCESS;
+}
+
+void FinishPlannerJob(struct Planner* planner, struct PlannerJob* job)
+{
+  struct PlannerGroup* group = FindPlannerGroup(planner, job->group);
+
+  if (job->state != PLANNER_JOB_RUNNING)
+    return;
+
+  job->state = PLANNER_JOB_DONE;
+  planner->running --;
+
+  // Our own call kept the TG busy, it has to be seen quiet again
+
+  group->running = 0;
+  group->quiet   = 0;
+
+  ReleasePlannerGroup(planner, group);
+}
+
+size_t StepPlanner(struct Planner* planner, uint64_t now)
+{
+  struct SessionTable* table = planner->table;
+  struct PlannerGroup* group;
+  struct PlannerJob** link;
+  struct PlannerJob* job;
+  uint32_t state;
+  size_t count = 0;
+  size_t index;
+
+  // Refresh quiet intervals from the latest poll answers
+
+  for (index = 0; index < planner->count; index ++)
+  {
+    group = planner->groups + index;
+    state = table->states[group->session];
+
+    if ((table->phases[group->session] != SESSION_STATE_ACTIVE) ||
+        (state == SESSION_POLL_UNKNOWN))
+      continue;
+
+    if (state != 0)
+      group->quiet = 0;
+    else if (group->quiet == 0)
+      group->quiet = now;
+  }
+
+  // Jobs are visited by deadline, so the most urgent job of any quiet TG takes a free slot first
+
+  link = &planner->jobs;
+
+  while ((job = *link) != NULL)
+  {
+    group = FindPlannerGroup(planner, job->group);
+
+    if (job->deadline < now)
+    {
+      *link = job->next;
+
+      job->state   = PLANNER_JOB_EXPIRED;
+      job->started = now;
+      planner->statistics.expired ++;
+
+      ReleasePlannerGroup(planner, group);
+
+      if (job->handler != NULL)
+        job->handler(job, PLANNER_EVENT_EXPIRED);
+
+      continue;
+    }
+
+    if ((planner->running < planner->limit) &&
+        (group->running == 0) &&
+        (group->quiet != 0) &&
+        ((now - group->quiet) >= job->pause))
+    {
+      *link = job->next;
+
+      job->state   = PLANNER_JOB_RUNNING;
+      job->started = now;
+
+      group->running = 1;
+      planner->running ++;
+
+      planner->statistics.started ++;
+      planner->statistics.waiting += now - job->submitted;
+      planner->statistics.slack   += job->deadline - now;
+
+      if (job->handler != NULL)
+        job->handler(job, PLANNER_EVENT_START);
+
+      count ++;
+      continue;
+    }
+
+    link = &job->next;
+  }
+
+  return count;
+}
+
+// Schedule runner
+
+#define SCHEDULE_LINE_SIZE   1024
+#define SCHEDULE_JOB_COUNT   256
+#define SCHEDULE_TIMEOUT     125
+
+#define SCHEDULE_PHASE_IDLE      0
+#define SCHEDULE_PHASE_STARTING  1  // Start task is queued on the pool
+#define SCHEDULE_PHASE_PLAYING   2  // Player is stepped by its shard
+#define SCHEDULE_PHASE_FINISHED  3  // Player is done or failed, main thread releases it once the shard let go
+#define SCHEDULE_PHASE_CLOSED    4
+
+struct ScheduleJob
+{
+  struct PlannerJob job;
+  struct PlayerSettings* settings;
+  struct SchedulerPool* pool;
+  struct SchedulerStream stream;
+  struct Player* player;
+  char* path;
+  int handle;
+  int result;
+  int phase;
+};
+
+static void FormatSeconds(char* buffer, size_t length, uint64_t value)
+{
+  snprintf(buffer, length, "%llu.%03llu s",
+    (unsigned long long)(value / NANOSECONDS_PER_SECOND),
+    (unsigned long long)(value / NANOSECONDS_PER_MILLISECOND % 1000));
+}
+
+static int StepScheduleJob(struct SchedulerStream* stream)
+{
+  struct ScheduleJob* entry = (struct ScheduleJob*)stream->data;
+
+  if (StepPlayer(entry->player) < PLAYER_STATE_DONE)
+  {
+    stream->due = GetPlayerDeadline(entry->player);
+    return 0;
+  }
+
+  __atomic_store_n(&entry->phase, SCHEDULE_PHASE_FINISHED, __ATOMIC_RELEASE);
+  return -1;
+}
+
+static void StartScheduleJob(void* data)
+{
+  struct ScheduleJob* entry = (struct ScheduleJob*)data;
+  struct PlayerSettings settings;
+
+  // TG is known to be quiet, the player goes on air without its own waiting
+
+  memcpy(&settings, entry->settings, sizeof(struct PlayerSettings));
+  settings.group = entry->job.group;
+  settings.wait  = 0;
+  settings.pause = 0;
+
+  entry->handle = open(entry->path, O_RDONLY);
+  entry->player = CreatePlayer(&settings);
+
+  if ((entry->handle < 0) ||
+      (entry->player == NULL) ||
+      (AttachPlayerInput(entry->player, entry->handle) != PLAYER_ERROR_SUCCESS) ||
+      (StartPlayer(entry->player) != PLAYER_ERROR_SUCCESS))
+  {
+    ReleasePlayer(entry->player);
+    entry->player = NULL;
+    entry->result = PLAYER_ERROR_INPUT;
+    __atomic_store_n(&entry->phase, SCHEDULE_PHASE_FINISHED, __ATOMIC_RELEASE);
+    return;
+  }
+
+  entry->stream.handle  = GetPlayerHandle(entry->player);
+  entry->stream.handler = StepScheduleJob;
+  entry->stream.data    = entry;
+  entry->stream.weight  = 1;
+  entry->stream.due     = GetPlayerDeadline(entry->player);
+
+  __atomic_store_n(&entry->phase, SCHEDULE_PHASE_PLAYING, __ATOMIC_RELEASE);
+
+  if (AttachSchedulerStream(entry->pool, &entry->stream) != SCHEDULER_ERROR_SUCCESS)
+  {
+    ReleasePlayer(entry->player);
+    entry->player = NULL;
+    entry->result = PLAYER_ERROR_RESOURCE;
+    __atomic_store_n(&entry->phase, SCHEDULE_PHASE_FINISHED, __ATOMIC_RELEASE);
+  }
+}
+
+static void HandleScheduleJob(struct PlannerJob* job, int event)
+{
+  struct ScheduleJob* entry = (struct ScheduleJob*)job;
+  char waiting[32];
+  char slack[32];
+
+  FormatSeconds(waiting, sizeof(waiting), job->started - job->submitted);
+
+  if (event == PLANNER_EVENT_EXPIRED)
+  {
+    printf("%s: EXPIRED, TG %u was not quiet for %llu s before the latest start (waited %s)\n",
+      entry->path,
+      job->group,
+      (unsigned long long)(job->pause / NANOSECONDS_PER_SECOND),
+      waiting);
+    entry->result = PLANNER_ERROR_EXPIRED;
+    return;
+  }
+
+  FormatSeconds(slack, sizeof(slack), job->deadline - job->started);
+  printf("%s: starting on TG %u, priority %i, waited %s, %s before the latest start\n",
+    entry->path,
+    job->group,
+    job->priority,
+    waiting,
+    slack);
+
+  // Opening the file and resolving the server may block, so it runs on the pool and not on the polling thread
+
+  entry->phase = SCHEDULE_PHASE_STARTING;
+
+  if (SubmitSchedulerTask(entry->pool, StartScheduleJob, entry) != SCHEDULER_ERROR_SUCCESS)
+    StartScheduleJob(entry);
+}
+
+static size_t ReadScheduleFile(const char* path, struct ScheduleJob* jobs, struct PlayerSettings* settings, uint64_t now, int* failures)
+{
+  char line[SCHEDULE_LINE_SIZE];
+  char deadline[64];
+  char name[SCHEDULE_LINE_SIZE];
+  unsigned int group;
+  int priority;
+  unsigned int pause;
+  ssize_t position;
+  size_t count = 0;
+  size_t number = 0;
+  FILE* file;
+
+  file = fopen(path, "r");
+
+  if (file == NULL)
+    return 0;
+
+  // <TG> <priority> <latest start from now, as --start-at> <quiet interval in seconds> <file>
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    number ++;
+
+    if ((line[0] == '#') ||
+        (line[strspn(line, " \t\r\n")] == '\0'))
+      continue;
+
+    if ((sscanf(line, "%u %i %63s %u %1023s", &group, &priority, deadline, &pause, name) != 5) ||
+        ((position = ParseInputPosition(deadline)) < 0))
+    {
+      printf("%s:%zu: ERROR invalid job line\n", path, number);
+      (*failures) ++;
+      continue;
+    }
+
+    if (count == SCHEDULE_JOB_COUNT)
+    {
+      printf("%s:%zu: ERROR more than %i jobs\n", path, number, SCHEDULE_JOB_COUNT);
+      (*failures) ++;
+      continue;
+    }
+
+    memset(jobs + count, 0, sizeof(struct ScheduleJob));
+
+    jobs[count].job.group    = group;
+    jobs[count].job.priority = priority;
+    jobs[count].job.deadline = now + position * INPUT_FRAME_DURATION * NANOSECONDS_PER_MILLISECOND;
+    jobs[count].job.pause    = pause * NANOSECONDS_PER_SECOND;
+    jobs[count].job.handler  = HandleScheduleJob;
+    jobs[count].settings     = settings;
+    jobs[count].path         = strdup(name);
+    jobs[count].handle       = -1;
+
+    count ++;
+  }
+
+  fclose(file);
+  return count;
+}
+
+int RunPlannerSchedule(int argc, char* argv[])
+{
+  struct PlayerSettings settings;
+  struct SessionTable* table;
+  struct ScheduleJob* jobs;
+  struct ScheduleJob* entry;
+  struct SchedulerPool* pool;
+  struct SchedulerStatistics statistics;
+  struct Planner planner;
+  size_t limit = 1;
+  size_t workers = 0;
+  size_t count;
+  size_t active;
+  size_t index;
+  int selection;
+  int address;
+  int value;
+  int phase;
+  int failures = 0;
+  uint64_t now;
+
+  struct option options[] =
+  {
+    { "client-password",  required_argument, NULL, 'w' },
+    { "client-number",    required_argument, NULL, 'c' },
+    { "server-address",   required_argument, NULL, 's' },
+    { "server-port",      required_argument, NULL, 'p' },
+    { "source-id",        required_argument, NULL, 'u' },
+    { "talker-alias",     required_argument, NULL, 't' },
+    { "linear",           no_argument,       NULL, 'l' },
+    { "mode33",           no_argument,       NULL, 'm' },
+    { "slots",            required_argument, NULL, 'n' },
+    { "workers",          required_argument, NULL, 'j' },
+    { NULL,               0,                 NULL, 0   }
+  };
+
+  memset(&settings, 0, sizeof(struct PlayerSettings));
+  settings.size     = DSD_AMBE_CHUNK_SIZE;
+  settings.liveness = 3;
+
+  while ((selection = getopt_long(argc, argv, "w:c:s:p:u:t:lmn:j:", options, NULL)) != EOF)
+    switch (selection)
+    {
+      case 'w':
+        settings.password = optarg;
+        break;
+
+      case 'c':
+        settings.number = strtol(optarg, NULL, 10);
+        break;
+
+      case 's':
+        settings.location = optarg;
+        break;
+
+      case 'p':
+        settings.port = optarg;
+        break;
+
+      case 'u':
+        settings.source = strtol(optarg, NULL, 10);
+        break;
+
+      case 't':
+        settings.alias = optarg;
+        break;
+
+      case 'l':
+        settings.size = LINEAR_FRAME_SIZE;
+        break;
+
+      case 'm':
+        settings.size = MODE33_FRAME_SIZE;
+        break;
+
+      case 'n':
+        value = strtol(optarg, NULL, 10);
+        limit = (value > 0) ? value : 1;
+        break;
+
+      case 'j':
+        value   = strtol(optarg, NULL, 10);
+        workers = (value > 0) ? value : 0;
+        break;
+    }
+
+  if ((optind >= argc) ||
+      (settings.password == NULL) ||
+      (settings.location == NULL) ||
+      (settings.number == 0) ||
+      (settings.source == 0))
+  {
+    printf(
+      "Usage:\n"
+      "  digestplay schedule --client-number <ID> --client-password <password> --server-address <address> [--server-port <port>]\n"
+      "    --source-id <ID> [--talker-alias <text>] [--linear | --mode33] [--slots <bulletins on air at once, default 1>]\n"
+      "    [--workers <player threads, default one per CPU up to the number of slots>] <job file>\n"
+      "\n"
+      "  Each line of the job file is: <TG> <priority> <latest start from now, as --start-at> <quiet seconds> <file>\n"
+      "\n");
+    return EXIT_FAILURE;
+  }
+
+  if (workers == 0)
+  {
+    value   = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = ((value > 0) && ((size_t)value < limit)) ? (size_t)value : limit;
+  }
+
+  now   = GetClockTime(NULL);
+  jobs  = (struct ScheduleJob*)calloc(SCHEDULE_JOB_COUNT, sizeof(struct ScheduleJob));
+  count = (jobs != NULL) ? ReadScheduleFile(argv[optind], jobs, &settings, now, &failures) : 0;
+  table = CreateSessionTable(PLANNER_GROUP_COUNT, "DigestPlay scheduler", settings.password);
+  pool  = CreateSchedulerPool(workers);
+
+  if ((count == 0) ||
+      (table == NULL) ||
+      (pool == NULL) ||
+      ((address = ResolveSessionAddress(table, settings.location, (settings.port != NULL) ? settings.port : "54005")) < 0))
+  {
+    printf("Error reading job file, starting workers or resolving server address\n");
+    ReleaseSchedulerPool(pool);
+    ReleaseSessionTable(table);
+    free(jobs);
+    return EXIT_FAILURE;
+  }
+
+  InitializePlanner(&planner, table, settings.number, address, limit);
+
+  for (index = 0; index < count; index ++)
+  {
+    jobs[index].pool   = pool;
+    jobs[index].result = SubmitPlannerJob(&planner, &jobs[index].job, now);
+
+    if (jobs[index].result == PLANNER_ERROR_EXPIRED)
+      printf("%s: EXPIRED before submission\n", jobs[index].path);
+
+    if (jobs[index].result == PLANNER_ERROR_SESSION)
+      printf("%s: FAILED, no session to poll TG %u\n", jobs[index].path, jobs[index].job.group);
+  }
+
+  // This thread drives polls of all TGs, players on air are stepped by the shards of the pool
+
+  do
+  {
+    active = 0;
+
+    for (index = 0; index < count; index ++)
+    {
+      entry = jobs + index;
+      phase = __atomic_load_n(&entry->phase, __ATOMIC_ACQUIRE);
+
+      if (phase == SCHEDULE_PHASE_IDLE)
+      {
+        active += (entry->job.state == PLANNER_JOB_PENDING) && (entry->result == 0);
+        continue;
+      }
+
+      if ((phase == SCHEDULE_PHASE_STARTING) ||
+          (phase == SCHEDULE_PHASE_PLAYING) ||
+          ((phase == SCHEDULE_PHASE_FINISHED) &&
+           (__atomic_load_n(&entry->stream.shard, __ATOMIC_ACQUIRE) != NULL)))
+      {
+        active ++;
+        continue;
+      }
+
+      if (phase == SCHEDULE_PHASE_CLOSED)
+        continue;
+
+      if (entry->player == NULL)
+      {
+        // Player could not be started
+        printf("%s: FAILED to start playout\n", entry->path);
+      }
+      else
+      {
+        printf("%s: %s, %llu packets sent\n",
+          entry->path,
+          (entry->player->state == PLAYER_STATE_DONE) ? "done" : "FAILED",
+          (unsigned long long)entry->player->count);
+
+        entry->result = entry->player->result;
+      }
+
+      FinishPlannerJob(&planner, &entry->job);
+      ReleasePlayer(entry->player);
+      close(entry->handle);
+      entry->player = NULL;
+      entry->phase  = SCHEDULE_PHASE_CLOSED;
+    }
+
+    ProcessSessionTable(table, SCHEDULE_TIMEOUT, GetClockTime(NULL));
+
+    now = GetClockTime(NULL);
+    AdvanceSessionTable(table, now);
+    StepPlanner(&planner, now);
+  }
+  while (active > 0);
+
+  printf("Scheduled %llu bulletins: %llu started, %llu expired, average wait %llu ms, average slack %llu ms\n",
+    (unsigned long long)planner.statistics.submitted,
+    (unsigned long long)planner.statistics.started,
+    (unsigned long long)planner.statistics.expired,
+    (unsigned long long)(planner.statistics.waiting / (planner.statistics.started + !planner.statistics.started) / NANOSECONDS_PER_MILLISECOND),
+    (unsigned long long)(planner.statistics.slack   / (planner.statistics.started + !planner.statistics.started) / NANOSECONDS_PER_MILLISECOND));
+
+  for (index = 0; index < pool->count; index ++)
+  {
+    GetSchedulerStatistics(pool, index, &statistics);
+    printf("Shard %zu: CPU %i, %llu ticks, average latency %llu us, worst %llu us, %llu late, %llu tasks (%llu stolen), %llu ms busy\n",
+      index,
+      pool->shards[index].processor,
+      (unsigned long long)statistics.ticks,
+      (unsigned long long)(statistics.latency / (statistics.ticks + !statistics.ticks) / 1000),
+      (unsigned long long)(statistics.maximum / 1000),
+      (unsigned long long)statistics.late,
+      (unsigned long long)statistics.tasks,
+      (unsigned long long)statistics.stolen,
+      (unsigned long long)(statistics.work / NANOSECONDS_PER_MILLISECOND));
+  }
+
+  ReleaseSchedulerPool(pool);
+
+  for (index = 0; index < count; index ++)
+  {
+    failures += (jobs[index].result != 0);
+    free(jobs[index].path);
+  }
+
+  ReleasePlanner(&planner);
+  ReleaseSessionTable(table);
+  free(jobs);
+
+  return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,107 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SessionTable.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define PLANNER_ERROR_SUCCESS     0
+#define PLANNER_ERROR_EXPIRED   -48
+#define PLANNER_ERROR_SESSION   -49
+
+#define PLANNER_JOB_PENDING       0
+#define PLANNER_JOB_RUNNING       1
+#define PLANNER_JOB_DONE          2
+#define PLANNER_JOB_EXPIRED       3
+#define PLANNER_JOB_FAILED        4  // No session could be opened to poll the TG
+
+#define PLANNER_EVENT_START       0  // TG is quiet, the job has to start its playout now
+#define PLANNER_EVENT_EXPIRED     1  // Latest start passed while the TG was busy or all slots were taken
+
+#define PLANNER_GROUP_COUNT       64
+
+struct PlannerJob;
+
+typedef void (*PlannerJobHandler)(struct PlannerJob* job, int event);
+
+struct PlannerJob
+{
+  struct PlannerJob* next;
+
+  uint32_t group;
+  int priority;         // Higher goes first among jobs with the same deadline
+  uint64_t deadline;    // Latest start time
+  uint64_t pause;       // Quiet interval the TG needs before the start, in nanoseconds
+  int state;            // PLANNER_JOB_*
+
+  uint64_t submitted;
+  uint64_t started;     // Time of start or expiry
+
+  PlannerJobHandler handler;
+  void* data;
+};
+
+// One polling session per TG of pending jobs, shared by all jobs of that TG
+
+struct PlannerGroup
+{
+  uint32_t group;
+  uint32_t session;
+  uint32_t jobs;        // Pending or running jobs of the TG
+  uint32_t running;     // Job of the TG is on air, the TG is taken by us
+  uint64_t quiet;       // Time the TG was first seen idle, 0 while busy
+};
+
+struct PlannerStatistics
+{
+  uint64_t submitted;
+  uint64_t started;
+  uint64_t expired;
+  uint64_t waiting;     // Sum of waits of started jobs in nanoseconds
+  uint64_t slack;       // Sum of time left to the deadline at start in nanoseconds
+};
+
+// Earliest deadline first across TGs: whenever a TG has been quiet long enough,
+// the pending job with the earliest latest-start among quiet TGs is started,
+// up to <limit> jobs on air at once. Jobs that cannot start before their
+// deadline are reported as expired.
+
+struct Planner
+{
+  struct SessionTable* table;
+  uint32_t number;
+  int address;
+  size_t limit;         // Jobs on air at once
+  size_t running;
+
+  struct PlannerJob* jobs;  // Pending jobs ordered by deadline, then priority
+  struct PlannerGroup groups[PLANNER_GROUP_COUNT];
+  size_t count;
+
+  struct PlannerStatistics statistics;
+};
+
+// Polls go through <table> with sessions of client <number> to server <address> (see ResolveSessionAddress)
+void InitializePlanner(struct Planner* planner, struct SessionTable* table, uint32_t number, int address, size_t limit);
+void ReleasePlanner(struct Planner* planner);
+
+int SubmitPlannerJob(struct Planner* planner, struct PlannerJob* job, uint64_t now);
+void FinishPlannerJob(struct Planner* planner, struct PlannerJob* job);
+
+// Expires and starts jobs by the poll states known at <now>, returns the number of jobs started
+size_t StepPlanner(struct Planner* planner, uint64_t now);
+
+// Entry point of "digestplay schedule [options] <job file>"
+int RunPlannerSchedule(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
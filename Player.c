@@ -0,0 +1,487 @@
+#include "Player.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <endian.h>
+
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define DEFAULT_PORT          "54005"
+#define BUFFER_SIZE           256
+
+#define FRAMES_PER_PACKET     3
+#define TDMA_FRAME_DURATION   60
+#define KEEP_ALIVE_INTERVAL   83
+
+#define ATTEMPT_COUNT         3
+#define RETRY_INTERVAL        2
+#define CONNECT_TIMEOUT       5
+
+#define HUNGRY_THRESHOLD      4
+
+static void FinishPlayer(struct Player* player, int state, int result)
+{
+  int event = (state == PLAYER_STATE_DONE) ? PLAYER_EVENT_COMPLETED : PLAYER_EVENT_FAILED;
+  struct itimerspec value;
+
+  if (player->state == PLAYER_STATE_PLAYING)
+  {
+    // Transmit call terminator
+    TransmitRewindData(player->context, REWIND_TYPE_DMR_DATA_BASE + 2, REWIND_FLAG_REAL_TIME_1, NULL, 0);
+  }
+
+  if (player->state != PLAYER_STATE_IDLE)
+    TransmitRewindClose(player->context);
+
+  // Disarm the timer, StartClockTicks treats zero delay as an immediate tick
+  memset(&value, 0, sizeof(struct itimerspec));
+  timerfd_settime(player->clock.handle, 0, &value, NULL);
+
+  player->state  = state;
+  player->result = result;
+
+  if (player->settings.callback != NULL)
+    player->settings.callback(player, event, player->settings.data);
+}
+
+static void StartPlayback(struct Player* player)
+{
+  player->state = PLAYER_STATE_PLAYING;
+
+  // First tick is due at once, the first audio packet follows the voice header immediately
+
+  player->header.type = htole32(SESSION_TYPE_GROUP_VOICE);
+  TransmitRewindData(player->context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, &player->header, sizeof(struct RewindSuperHeader));
+  TransmitRewindData(player->context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, &player->header, sizeof(struct RewindSuperHeader));
+  TransmitRewindData(player->context, REWIND_TYPE_SUPER_HEADER, REWIND_FLAG_REAL_TIME_1, &player->header, sizeof(struct RewindSuperHeader));
+
+  StartClockTicks(&player->clock, TDMA_FRAME_DURATION * NANOSECONDS_PER_MILLISECOND, 0);
+}
+
+static void StartWaiting(struct Player* player, uint64_t now)
+{
+  time_t interval = player->settings.wait;
+
+  if (interval < RETRY_INTERVAL)
+    interval = RETRY_INTERVAL;
+
+  player->state     = PLAYER_STATE_WAITING;
+  player->deadline  = now + (interval + player->settings.pause) * NANOSECONDS_PER_SECOND;
+  player->threshold = 0;
+
+  player->poll.type   = htole32(TREE_SESSION_BY_TARGET);
+  player->poll.flag   = htole32(SESSION_TYPE_FLAG_GROUP);
+  player->poll.number = htole32(player->settings.group);
+
+  TransmitRewindKeepAlive(player->context);
+  TransmitRewindData(player->context, REWIND_TYPE_SESSION_POLL, REWIND_FLAG_NONE, &player->poll, sizeof(struct RewindSessionPollData));
+}
+
+static size_t TakePlayerFrames(struct Player* player, uint8_t* buffer)
+{
+  size_t length = FRAMES_PER_PACKET * player->settings.size;
+
+  if (player->attached != 0)
+    return ReadFilteredFrames(&player->input, &player->filter, buffer, FRAMES_PER_PACKET);
+
+  if ((player->length - player->offset) < length)
+    return 0;
+
+  memcpy(buffer, player->queue + player->offset, length);
+  player->offset += length;
+  return FRAMES_PER_PACKET;
+}
+
+static void TransmitPlayerPacket(struct Player* player, uint64_t now)
+{
+  struct RewindContext* context = player->context;
+  uint8_t buffer[FRAMES_PER_PACKET * MODE33_FRAME_SIZE];
+  uint8_t output[FRAMES_PER_PACKET * MODE33_FRAME_SIZE];
+  const uint8_t* silence;
+  uint8_t* payload;
+  size_t format = player->settings.format;
+  size_t index;
+
+  if (TakePlayerFrames(player, buffer) < FRAMES_PER_PACKET)
+  {
+    if ((player->attached != 0) ||
+        (player->finished != 0))
+    {
+      FinishPlayer(player, PLAYER_STATE_DONE, PLAYER_ERROR_SUCCESS);
+      return;
+    }
+
+    // Fed input is late, keep the call open with silence
+
+    silence = (format == MODE33_FRAME_SIZE) ? AMBESilenceMode33 : AMBESilenceLinear;
+
+    for (index = 0; index < FRAMES_PER_PACKET; index ++)
+      memcpy(output + index * format, silence, format);
+
+    payload = output;
+    player->underruns ++;
+  }
+  else if (player->settings.size != format)
+  {
+    TranscodeAMBEFrames(output, format, buffer, player->settings.size, FRAMES_PER_PACKET);
+    payload = output;
+  }
+  else
+    payload = buffer;
+
+  TransmitRewindData(context, REWIND_TYPE_DMR_AUDIO_FRAME, REWIND_FLAG_REAL_TIME_1, payload, FRAMES_PER_PACKET * format);
+
+  if ((player->count % KEEP_ALIVE_INTERVAL) == 0)
+    TransmitRewindKeepAlive(context);
+
+  if (player->count == 0)
+  {
+    player->first = now - player->start;
+
+    if (player->settings.callback != NULL)
+      player->settings.callback(player, PLAYER_EVENT_STARTED, player->settings.data);
+  }
+
+  player->count ++;
+
+  if ((player->attached == 0) &&
+      (player->finished == 0) &&
+      ((player->length - player->offset) < (HUNGRY_THRESHOLD * FRAMES_PER_PACKET * player->settings.size)) &&
+      (player->settings.callback != NULL))
+    player->settings.callback(player, PLAYER_EVENT_HUNGRY, player->settings.data);
+}
+
+static void HandlePlayerData(struct Player* player, struct RewindData* buffer, ssize_t length, uint64_t now)
+{
+  struct RewindSessionPollData* response = (struct RewindSessionPollData*)buffer->data;
+
+  switch (player->state)
+  {
+    case PLAYER_STATE_CONNECTING:
+      switch (le16toh(buffer->type))
+      {
+        case REWIND_TYPE_CHALLENGE:
+          if (player->attempt >= ATTEMPT_COUNT)
+          {
+            FinishPlayer(player, PLAYER_STATE_FAILED, CLIENT_ERROR_WRONG_PASSWORD);
+            break;
+          }
+          AnswerRewindChallenge(player->context, buffer, length, player->settings.password);
+          player->attempt ++;
+          break;
+
+        case REWIND_TYPE_KEEP_ALIVE:
+          __atomic_store_n(&player->context->session.latency, now - player->start, __ATOMIC_RELAXED);
+
+          if (player->settings.callback != NULL)
+            player->settings.callback(player, PLAYER_EVENT_CONNECTED, player->settings.data);
+
+          if ((player->settings.wait  > 0) ||
+              (player->settings.pause > 0))
+          {
+            StartWaiting(player, now);
+            break;
+          }
+
+          StartPlayback(player);
+          break;
+      }
+      break;
+
+    case PLAYER_STATE_WAITING:
+      if ((le16toh(buffer->type) != REWIND_TYPE_SESSION_POLL) ||
+          (length < (sizeof(struct RewindData) + sizeof(struct RewindSessionPollData))))
+        break;
+
+      // Talkgroup has to stay quiet for <pause> seconds
+
+      if (response->state != 0)
+        player->threshold = 0;
+      else if (player->threshold == 0)
+        player->threshold = now + player->settings.pause * NANOSECONDS_PER_SECOND;
+
+      if ((player->threshold != 0) &&
+          (now >= player->threshold))
+      {
+        __atomic_store_n(&player->context->session.waiting, player->context->session.waiting + now - player->start - player->context->session.latency, __ATOMIC_RELAXED);
+        StartPlayback(player);
+      }
+      break;
+  }
+}
+
+struct Player* CreatePlayer(const struct PlayerSettings* settings)
+{
+  struct Player* player = (struct Player*)calloc(1, sizeof(struct Player));
+  struct epoll_event event;
+
+  if (player == NULL)
+    return NULL;
+
+  memcpy(&player->settings, settings, sizeof(struct PlayerSettings));
+
+  if (player->settings.port == NULL)
+    player->settings.port = DEFAULT_PORT;
+
+  if (player->settings.format == 0)
+    player->settings.format = (settings->size == MODE33_FRAME_SIZE) ? MODE33_FRAME_SIZE : LINEAR_FRAME_SIZE;
+
+  player->handle  = epoll_create1(EPOLL_CLOEXEC);
+  player->context = CreateRewindContext(settings->number, "DigestPlay library");
+
+  if ((player->handle < 0) ||
+      (player->context == NULL) ||
+      (InitializeClock(&player->clock, CLOCK_MODE_REAL) < 0))
+  {
+    ReleasePlayer(player);
+    return NULL;
+  }
+
+  InitializeSilenceFilter(&player->filter, settings->size, settings->silence);
+
+  player->context->clock    = &player->clock;
+  player->context->liveness = settings->liveness;
+
+  // Timer and socket are polled through one descriptor, reads never block
+
+  fcntl(player->clock.handle, F_SETFL, fcntl(player->clock.handle, F_GETFL) | O_NONBLOCK);
+
+  event.events  = EPOLLIN;
+  event.data.fd = player->clock.handle;
+  epoll_ctl(player->handle, EPOLL_CTL_ADD, player->clock.handle, &event);
+
+  event.events  = EPOLLIN;
+  event.data.fd = player->context->handle;
+  epoll_ctl(player->handle, EPOLL_CTL_ADD, player->context->handle, &event);
+
+  player->header.sourceID      = htole32(settings->source);
+  player->header.destinationID = htole32(settings->group);
+
+  if (settings->alias != NULL)
+    strncpy(player->header.sourceCall, settings->alias, REWIND_CALL_LENGTH);
+
+  return player;
+}
+
+void ReleasePlayer(struct Player* player)
+{
+  if (player != NULL)
+  {
+    if ((player->state == PLAYER_STATE_CONNECTING) ||
+        (player->state == PLAYER_STATE_WAITING) ||
+        (player->state == PLAYER_STATE_PLAYING))
+      StopPlayer(player);
+
+    if (player->attached != 0)
+      CloseInputStream(&player->input);
+
+    if (player->handle >= 0)
+      close(player->handle);
+
+    ReleaseClock(&player->clock);
+    ReleaseRewindContext(player->context);
+    free(player->queue);
+    free(player);
+  }
+}
+
+int AttachPlayerInput(struct Player* player, int handle)
+{
+  struct stat status;
+
+  if ((player->attached != 0) ||
+      (player->length > 0))
+    return PLAYER_ERROR_STATE;
+
+  // Reads of pipes and sockets could stall the caller's event loop, such input has to be fed
+
+  if ((fstat(handle, &status) < 0) ||
+      (!S_ISREG(status.st_mode)) ||
+      (OpenInputStream(&player->input, handle, player->settings.size) != INPUT_ERROR_SUCCESS))
+    return PLAYER_ERROR_INPUT;
+
+  player->attached = 1;
+  return PLAYER_ERROR_SUCCESS;
+}
+
+void AttachPlayerFrames(struct Player* player, const uint8_t* data, size_t count)
+{
+  AttachInputStream(&player->input, data, count, player->settings.size);
+  player->attached = 1;
+}
+
+int FeedPlayerFrames(struct Player* player, const uint8_t* data, size_t count)
+{
+  size_t length = count * player->settings.size;
+  uint8_t* queue;
+
+  if ((player->attached != 0) ||
+      (player->finished != 0))
+    return PLAYER_ERROR_STATE;
+
+  if (player->offset > 0)
+  {
+    // Drop what is played already
+    memmove(player->queue, player->queue + player->offset, player->length - player->offset);
+    player->length -= player->offset;
+    player->offset  = 0;
+  }
+
+  if ((player->length + length) > player->capacity)
+  {
+    queue = (uint8_t*)realloc(player->queue, player->length + length);
+
+    if (queue == NULL)
+      return PLAYER_ERROR_RESOURCE;
+
+    player->queue    = queue;
+    player->capacity = player->length + length;
+  }
+
+  memcpy(player->queue + player->length, data, length);
+  player->length += FilterSilenceFrames(&player->filter, player->queue + player->length, count) * player->settings.size;
+  return PLAYER_ERROR_SUCCESS;
+}
+
+void FinishPlayerInput(struct Player* player)
+{
+  player->finished = 1;
+}
+
+int StartPlayer(struct Player* player)
+{
+  int result;
+
+  if (player->state != PLAYER_STATE_IDLE)
+    return PLAYER_ERROR_STATE;
+
+  result = ResolveRewindAddress(player->context, player->settings.location, player->settings.port);
+
+  if (result != CLIENT_ERROR_SUCCESS)
+  {
+    FinishPlayer(player, PLAYER_STATE_FAILED, result);
+    return result;
+  }
+
+  // Keep-alive is repeated until the server answers or the login times out
+
+  player->state    = PLAYER_STATE_CONNECTING;
+  player->start    = GetClockTime(&player->clock);
+  player->deadline = player->start + CONNECT_TIMEOUT * NANOSECONDS_PER_SECOND;
+
+  TransmitRewindKeepAlive(player->context);
+  StartClockTicks(&player->clock, RETRY_INTERVAL * NANOSECONDS_PER_SECOND, RETRY_INTERVAL * NANOSECONDS_PER_SECOND);
+
+  return PLAYER_ERROR_SUCCESS;
+}
+
+void StopPlayer(struct Player* player)
+{
+  if ((player->state == PLAYER_STATE_CONNECTING) ||
+      (player->state == PLAYER_STATE_WAITING) ||
+      (player->state == PLAYER_STATE_PLAYING))
+    FinishPlayer(player, PLAYER_STATE_DONE, PLAYER_ERROR_SUCCESS);
+}
+
+int GetPlayerHandle(struct Player* player)
+{
+  return player->handle;
+}
+
+int GetPlayerTimeout(struct Player* player)
+{
+  struct itimerspec value;
+
+  if ((player->state == PLAYER_STATE_IDLE) ||
+      (player->state == PLAYER_STATE_DONE) ||
+      (player->state == PLAYER_STATE_FAILED) ||
+      (timerfd_gettime(player->clock.handle, &value) < 0))
+    return -1;
+
+  // Round up, waking up early would only cost an empty step
+
+  return value.it_value.tv_sec * 1000 + (value.it_value.tv_nsec + NANOSECONDS_PER_MILLISECOND - 1) / NANOSECONDS_PER_MILLISECOND;
+}
+
+uint64_t GetPlayerDeadline(struct Player* player)
+{
+  struct itimerspec value;
+
+  if ((player->state == PLAYER_STATE_IDLE) ||
+      (player->state == PLAYER_STATE_DONE) ||
+      (player->state == PLAYER_STATE_FAILED) ||
+      (timerfd_gettime(player->clock.handle, &value) < 0) ||
+      ((value.it_value.tv_sec == 0) &&
+       (value.it_value.tv_nsec == 0)))
+    return 0;
+
+  return GetClockTime(NULL) + value.it_value.tv_sec * NANOSECONDS_PER_SECOND + value.it_value.tv_nsec;
+}
+
+int StepPlayer(struct Player* player)
+{
+  struct RewindData* buffer = (struct RewindData*)alloca(BUFFER_SIZE);
+  struct epoll_event events[2];
+  ssize_t length;
+  ssize_t ticks;
+  uint64_t now;
+
+  // Empty the readiness list of the descriptor, both sources are checked below anyway
+
+  epoll_wait(player->handle, events, 2, 0);
+
+  now = GetClockTime(&player->clock);
+
+  while ((player->state != PLAYER_STATE_IDLE) &&
+         (player->state != PLAYER_STATE_DONE) &&
+         (player->state != PLAYER_STATE_FAILED) &&
+         (((length = FetchRewindData(player->context, buffer, BUFFER_SIZE)) >= 0) ||
+          (length == CLIENT_ERROR_WRONG_ADDRESS) ||
+          (length == CLIENT_ERROR_WRONG_DATA)))
+    if (length >= 0)
+      HandlePlayerData(player, buffer, length, now);
+
+  ticks = WaitForClockTick(&player->clock);
+
+  if (ticks <= 0)
+    return player->state;
+
+  switch (player->state)
+  {
+    case PLAYER_STATE_CONNECTING:
+      if (now >= player->deadline)
+      {
+        FinishPlayer(player, PLAYER_STATE_FAILED, CLIENT_ERROR_RESPONSE_TIMEOUT);
+        break;
+      }
+      TransmitRewindKeepAlive(player->context);
+      break;
+
+    case PLAYER_STATE_WAITING:
+      if (now >= player->deadline)
+      {
+        FinishPlayer(player, PLAYER_STATE_FAILED, CLIENT_ERROR_RESPONSE_TIMEOUT);
+        break;
+      }
+      TransmitRewindKeepAlive(player->context);
+      TransmitRewindData(player->context, REWIND_TYPE_SESSION_POLL, REWIND_FLAG_NONE, &player->poll, sizeof(struct RewindSessionPollData));
+      break;
+
+    case PLAYER_STATE_PLAYING:
+      if (CheckRewindLiveness(player->context) != CLIENT_ERROR_SUCCESS)
+      {
+        FinishPlayer(player, PLAYER_STATE_FAILED, CLIENT_ERROR_RESPONSE_TIMEOUT);
+        break;
+      }
+      TransmitPlayerPacket(player, now);
+      break;
+  }
+
+  return player->state;
+}
@@ -0,0 +1,128 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "RewindClient.h"
+#include "Input.h"
+#include "Clock.h"
+#include "AMBE.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define PLAYER_STATE_IDLE         0
+#define PLAYER_STATE_CONNECTING   1
+#define PLAYER_STATE_WAITING      2
+#define PLAYER_STATE_PLAYING      3
+#define PLAYER_STATE_DONE         4
+#define PLAYER_STATE_FAILED       5
+
+#define PLAYER_EVENT_CONNECTED    0  // Login is complete
+#define PLAYER_EVENT_STARTED      1  // First audio frame is sent
+#define PLAYER_EVENT_HUNGRY       2  // Fed frames run low, feed more or finish input
+#define PLAYER_EVENT_COMPLETED    3  // Input is played out, call is closed
+#define PLAYER_EVENT_FAILED       4  // See <result> for CLIENT_ERROR_* code
+
+#define PLAYER_ERROR_SUCCESS      0
+#define PLAYER_ERROR_STATE       -16
+#define PLAYER_ERROR_INPUT       -17
+#define PLAYER_ERROR_RESOURCE    -18
+
+struct Player;
+
+typedef void (*PlayerCallback)(struct Player* player, int event, void* data);
+
+// Strings are not copied and have to outlive the player
+
+struct PlayerSettings
+{
+  uint32_t number;        // Registered ID of client
+  const char* password;
+  const char* location;   // Server address
+  const char* port;       // NULL for the default port
+
+  uint32_t source;        // Source ID
+  uint32_t group;         // TG ID
+  const char* alias;      // Talker alias, may be NULL
+
+  size_t size;            // Input frame size: DSD_AMBE_CHUNK_SIZE, LINEAR_FRAME_SIZE or MODE33_FRAME_SIZE
+  size_t format;          // Frame size to transmit, 0 sends DSD as linear and the rest as is
+
+  time_t wait;            // Limit and quiet interval of the talkgroup in seconds, as --wait and --pause
+  time_t pause;           // of the command line tool, both 0 to start at once
+  uint32_t liveness;      // Unanswered keep-alives to fail with, 0 to disable
+  size_t silence;         // Longest silence run to send in frames, 0 to send everything
+
+  PlayerCallback callback;
+  void* data;
+};
+
+// Non-blocking playout driven by the caller's event loop: poll the descriptor of
+// GetPlayerHandle for reading (or wait GetPlayerTimeout milliseconds) and call
+// StepPlayer whenever it is ready. Only name resolution in StartPlayer blocks.
+
+struct Player
+{
+  int state;
+  int result;
+  int handle;
+
+  struct PlayerSettings settings;
+  struct RewindContext* context;
+  struct Clock clock;
+
+  struct RewindSuperHeader header;
+  struct RewindSessionPollData poll;
+
+  // Input is either a stream (regular file or clip read without blocking) or frames fed by the caller
+  struct InputStream input;
+  int attached;
+  uint8_t* queue;
+  size_t length;
+  size_t capacity;
+  size_t offset;
+  int finished;
+  struct SilenceFilter filter;
+
+  size_t attempt;
+  uint64_t start;
+  uint64_t deadline;
+  uint64_t threshold;
+
+  uint64_t count;         // Audio packets sent
+  uint64_t underruns;     // Packets of silence sent while no frames were fed
+  uint64_t first;         // Time from start to the first audio packet in nanoseconds
+};
+
+struct Player* CreatePlayer(const struct PlayerSettings* settings);
+void ReleasePlayer(struct Player* player);
+
+// Either attach a descriptor of a regular file (ownership stays with the caller) or feed frames
+// before or during playout, other descriptors are rejected with PLAYER_ERROR_INPUT
+int AttachPlayerInput(struct Player* player, int handle);
+void AttachPlayerFrames(struct Player* player, const uint8_t* data, size_t count);
+int FeedPlayerFrames(struct Player* player, const uint8_t* data, size_t count);
+void FinishPlayerInput(struct Player* player);
+
+int StartPlayer(struct Player* player);
+void StopPlayer(struct Player* player);
+
+int GetPlayerHandle(struct Player* player);
+int GetPlayerTimeout(struct Player* player);
+
+// Monotonic time in nanoseconds when the timer of the player fires next, 0 if it is not armed
+uint64_t GetPlayerDeadline(struct Player* player);
+
+// Processes everything that is due and returns the new state
+int StepPlayer(struct Player* player);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
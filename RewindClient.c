@@ -1,4 +1,5 @@
 #include "RewindClient.h"
+#include "Trace.h"
 
 #include <unistd.h>
 #include <string.h>
@@ -8,7 +9,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <poll.h>
+
 #include <sys/time.h>
+#include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/utsname.h>
 
@@ -31,6 +35,7 @@
 #ifdef __linux__
 #include <endian.h>
 #include <byteswap.h>
+#include <linux/sockios.h>
 #endif
 
 #ifdef __MACH__
@@ -57,6 +62,13 @@
 #define RECEIVE_TIMEOUT  2
 #define CONNECT_TIMEOUT  5
 
+#define SEND_QUEUE_LENGTH  64
+#define SEND_PACKET_COST   2048
+
+#define PROBE_TIMEOUT_INITIAL  (1000 * NANOSECONDS_PER_MILLISECOND)
+#define PROBE_TIMEOUT_MINIMUM  (250  * NANOSECONDS_PER_MILLISECOND)
+#define PROBE_TIMEOUT_MAXIMUM  (RECEIVE_TIMEOUT * NANOSECONDS_PER_SECOND)
+
 static int CompareAddresses(struct sockaddr* value1, struct sockaddr_in6* value2)
 {
   struct sockaddr_in* value;
@@ -85,8 +97,10 @@ struct RewindContext* CreateRewindContext(uint32_t number, const char* verion)
 {
   struct utsname name;
   struct timeval interval;
+  socklen_t size = sizeof(int);
+  int value;
   struct sockaddr_in6 address;
-  struct RewindContext* context = (struct RewindContext*)calloc(1, sizeof(struct RewindContext));
+  struct RewindContext* context = (struct RewindContext*)calloc(1, sizeof(struct RewindContext) + BUFFER_SIZE);
 
   if (context != NULL)
   {
@@ -110,22 +124,47 @@ struct RewindContext* CreateRewindContext(uint32_t number, const char* verion)
       return NULL;
     }
 
-    // Create supplementary data
+    // Make sure the send queue holds a burst of packets, counting kernel overhead per datagram
+
+    getsockopt(context->handle, SOL_SOCKET, SO_SNDBUF, &context->transmission.buffer, &size);
+
+    if (context->transmission.buffer < (SEND_QUEUE_LENGTH * SEND_PACKET_COST))
+    {
+      value = SEND_QUEUE_LENGTH * SEND_PACKET_COST;
+      setsockopt(context->handle, SOL_SOCKET, SO_SNDBUF, &value, sizeof(int));
+      getsockopt(context->handle, SOL_SOCKET, SO_SNDBUF, &context->transmission.buffer, &size);
+    }
+
+    // Create supplementary data, stored right after the context to keep it in one allocation
 
     uname(&name);
 
-    context->data = (struct RewindVersionData*)malloc(BUFFER_SIZE);
+    context->data = (struct RewindVersionData*)(context + 1);
 
     context->length  = sizeof(struct RewindVersionData);
-    context->length += sprintf(
+    context->length += snprintf(
       context->data->description,
+      BUFFER_SIZE - sizeof(struct RewindVersionData),
       "%s %s %s",
       verion,
       name.sysname,
       name.machine);
 
+    if (context->length >= BUFFER_SIZE)
+      context->length = BUFFER_SIZE - 1;
+
     context->data->number = htole32(number);
     context->data->service = REWIND_SERVICE_SIMPLE_APPLICATION;
+
+    // Prepare packet template
+
+    memcpy(context->header.sign, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH);
+
+    context->vectors[0].iov_base = &context->header;
+    context->vectors[0].iov_len  = sizeof(struct RewindData);
+
+    context->message.msg_iov    = context->vectors;
+    context->message.msg_iovlen = 2;
   }
 
   return context;
@@ -137,55 +176,185 @@ void ReleaseRewindContext(struct RewindContext* context)
   {
     freeaddrinfo(context->address);
     close(context->handle);
-    free(context->data);
     free(context);
   }
 }
 
-void TransmitRewindData(struct RewindContext* context, uint16_t type, uint16_t flag, void* data, size_t length)
+struct msghdr* PrepareRewindData(struct RewindContext* context, uint16_t type, uint16_t flag, void* data, size_t length)
 {
-  struct msghdr message;
-  struct iovec vectors[2];
+  size_t index;
+
+  index = flag & REWIND_FLAG_REAL_TIME_1;
+
+  context->header.type   = htole16(type);
+  context->header.flags  = htole16(flag);
+  context->header.number = htole32(context->counters[index]);
+  context->header.length = htole16(length);
+
+  context->vectors[1].iov_base = data;
+  context->vectors[1].iov_len  = length;
+
+  // Counters read by the metrics thread have a single writer, relaxed stores keep them race-free
+  __atomic_store_n(&context->counters[index], context->counters[index] + 1, __ATOMIC_RELAXED);
 
+  return &context->message;
+}
+
+ssize_t TransmitRewindData(struct RewindContext* context, uint16_t type, uint16_t flag, void* data, size_t length)
+{
+  struct msghdr* message;
+  uint64_t now;
+  uint64_t threshold;
+  struct pollfd event;
+  ssize_t result;
   size_t index;
-  uint32_t number;
 
-  struct RewindData header;
+  message = PrepareRewindData(context, type, flag, data, length);
+  length += sizeof(struct RewindData);
 
-  memset(&header, 0, sizeof(struct RewindData));
-  memcpy(&header, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH);
- 
-  index = flag & REWIND_FLAG_REAL_TIME_1;
-  number = context->counters[index];
-
-  header.type   = htole16(type);
-  header.flags  = htole16(flag);
-  header.number = htole32(number);
-  header.length = htole16(length);
-
-  vectors[0].iov_base    = &header;
-  vectors[0].iov_len     = sizeof(struct RewindData);
-  vectors[1].iov_base    = data;
-  vectors[1].iov_len     = length;
-  message.msg_name       = context->address->ai_addr;
-  message.msg_namelen    = context->address->ai_addrlen;
-  message.msg_iov        = vectors;
-  message.msg_iovlen     = 2;
-  message.msg_control    = NULL;
-  message.msg_controllen = 0;
-  message.msg_flags      = 0;
-
-  sendmsg(context->handle, &message, 0);
-
-  context->counters[index] ++;
+  if ((type == REWIND_TYPE_KEEP_ALIVE) ||
+      (type == REWIND_TYPE_SESSION_POLL))
+  {
+    // Start round-trip measurement
+    index = (type == REWIND_TYPE_SESSION_POLL);
+    context->probes[index].time = GetClockTime(context->clock);
+    context->probes[index].count ++;
+    __atomic_store_n(&context->session.keepalives, context->session.keepalives + (type == REWIND_TYPE_KEEP_ALIVE), __ATOMIC_RELAXED);
+    __atomic_store_n(&context->session.polls,      context->session.polls      + (type == REWIND_TYPE_SESSION_POLL), __ATOMIC_RELAXED);
+  }
+
+  result = sendmsg(context->handle, message, MSG_DONTWAIT);
+
+  if ((result < 0) &&
+      (context->retry > 0) &&
+      ((errno == EAGAIN) ||
+       (errno == EWOULDBLOCK) ||
+       (errno == ENOBUFS) ||
+       (errno == EINTR)))
+  {
+    // Retry while the budget lasts, waiting for room in the send queue
+
+    // Budget is capped, so a congested socket cannot stall the pacing loop past the next tick
+
+    now = GetClockTime(NULL);
+    threshold = now + ((context->retry < REWIND_RETRY_LIMIT) ? context->retry : REWIND_RETRY_LIMIT) * 1000ULL;
+
+    event.fd     = context->handle;
+    event.events = POLLOUT;
+
+    while ((result < 0) &&
+           (now < threshold) &&
+           ((errno == EAGAIN) ||
+            (errno == EWOULDBLOCK) ||
+            (errno == ENOBUFS) ||
+            (errno == EINTR)))
+    {
+      poll(&event, 1, (threshold - now + NANOSECONDS_PER_MILLISECOND - 1) / NANOSECONDS_PER_MILLISECOND);
+      result = sendmsg(context->handle, message, MSG_DONTWAIT);
+      context->transmission.retries ++;
+      now = GetClockTime(NULL);
+    }
+  }
+
+  if (context->trace != NULL)
+    RecordTrace(context->trace, TRACE_DIRECTION_SEND, &context->header, GetClockTime(context->clock), result < 0);
+
+  if (result < 0)
+  {
+    context->transmission.error = errno;
+    __atomic_store_n(&context->transmission.failures, context->transmission.failures + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&context->transmission.congestion, context->transmission.congestion +
+      ((errno == EAGAIN) ||
+       (errno == EWOULDBLOCK) ||
+       (errno == ENOBUFS)), __ATOMIC_RELAXED);
+    return CLIENT_ERROR_SOCKET_IO;
+  }
+
+  if (result < length)
+  {
+    __atomic_store_n(&context->transmission.shorts, context->transmission.shorts + 1, __ATOMIC_RELAXED);
+    return CLIENT_ERROR_SHORT_SEND;
+  }
+
+  __atomic_store_n(&context->transmission.packets, context->transmission.packets + 1, __ATOMIC_RELAXED);
+  return result;
 }
 
-ssize_t ReceiveRewindData(struct RewindContext* context, struct RewindData* buffer, ssize_t length)
+int SampleRewindSendQueue(struct RewindContext* context)
+{
+#ifdef SIOCOUTQ
+  int value;
+
+  if (ioctl(context->handle, SIOCOUTQ, &value) < 0)
+    return CLIENT_ERROR_SOCKET_IO;
+
+  __atomic_store_n(&context->transmission.queue, value, __ATOMIC_RELAXED);
+
+  if (context->transmission.peak < value)
+    context->transmission.peak = value;
+
+  return value;
+#else
+  return 0;
+#endif
+}
+
+static uint64_t GetRewindProbeTimeout(struct RewindContext* context)
+{
+  uint64_t timeout;
+
+  if (context->session.smoothed == 0)
+    return PROBE_TIMEOUT_INITIAL;
+
+  timeout = context->session.smoothed + 4 * context->session.variation;
+
+  if (timeout < PROBE_TIMEOUT_MINIMUM)
+    return PROBE_TIMEOUT_MINIMUM;
+  if (timeout > PROBE_TIMEOUT_MAXIMUM)
+    return PROBE_TIMEOUT_MAXIMUM;
+
+  return timeout;
+}
+
+static void CompleteRewindProbe(struct RewindContext* context, size_t index, uint64_t now)
+{
+  struct RewindSessionStatistics* session = &context->session;
+  struct RewindProbe* probe = context->probes + index;
+  uint64_t sample;
+  uint64_t deviation;
+
+  if (probe->count == 1)
+  {
+    // Smooth as TCP does (RFC 6298), samples of repeated probes are ambiguous (Karn)
+
+    sample    = now - probe->time;
+    deviation = (session->smoothed > sample) ? (session->smoothed - sample) : (sample - session->smoothed);
+
+    if (session->smoothed == 0)
+    {
+      __atomic_store_n(&session->smoothed, sample, __ATOMIC_RELAXED);
+      session->variation = sample / 2;
+    }
+    else
+    {
+      session->variation = (3 * session->variation + deviation) / 4;
+      __atomic_store_n(&session->smoothed, (7 * session->smoothed + sample) / 8, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&session->rtt, sample, __ATOMIC_RELAXED);
+  }
+
+  probe->time  = 0;
+  probe->count = 0;
+}
+
+static ssize_t ReceiveRewindPacket(struct RewindContext* context, struct RewindData* buffer, ssize_t length, int flags)
 {
   struct sockaddr_in6 address;
   socklen_t size = sizeof(struct sockaddr_in6);
+  uint64_t now;
 
-  length = recvfrom(context->handle, buffer, length, 0, (struct sockaddr*)&address, &size);
+  length = recvfrom(context->handle, buffer, length, flags, (struct sockaddr*)&address, &size);
 
   if (length < 0)
     return CLIENT_ERROR_SOCKET_IO;
@@ -197,30 +366,96 @@ ssize_t ReceiveRewindData(struct RewindContext* context, struct RewindData* buff
       (memcmp(buffer, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH) != 0))
     return CLIENT_ERROR_WRONG_DATA;
 
+  // Any packet from the server proves it is alive
+
+  now = GetClockTime(context->clock);
+
+  if (context->trace != NULL)
+    RecordTrace(context->trace, TRACE_DIRECTION_RECEIVE, buffer, now, 0);
+
+  context->session.answered = now;
+  context->session.missed   = 0;
+
+  switch (le16toh(buffer->type))
+  {
+    case REWIND_TYPE_KEEP_ALIVE:
+      __atomic_store_n(&context->session.answers, context->session.answers + 1, __ATOMIC_RELAXED);
+      CompleteRewindProbe(context, REWIND_PROBE_KEEP_ALIVE, now);
+      break;
+
+    case REWIND_TYPE_SESSION_POLL:
+      CompleteRewindProbe(context, REWIND_PROBE_SESSION_POLL, now);
+      break;
+  }
+
   return length;
 }
 
-int ConnectRewindClient(struct RewindContext* context, const char* location, const char* port, const char* password, uint32_t options)
+ssize_t ReceiveRewindData(struct RewindContext* context, struct RewindData* buffer, ssize_t length)
 {
-  struct addrinfo hints;
+  return ReceiveRewindPacket(context, buffer, length, 0);
+}
 
+ssize_t FetchRewindData(struct RewindContext* context, struct RewindData* buffer, ssize_t length)
+{
+  return ReceiveRewindPacket(context, buffer, length, MSG_DONTWAIT);
+}
+
+int ProcessRewindData(struct RewindContext* context)
+{
   struct RewindData* buffer = (struct RewindData*)alloca(BUFFER_SIZE);
   ssize_t length;
+  int count = 0;
 
-  size_t attempt = 0;
-  struct timeval now;
-  struct timeval threshold;
+  while (((length = ReceiveRewindPacket(context, buffer, BUFFER_SIZE, MSG_DONTWAIT)) >= 0) ||
+         (length == CLIENT_ERROR_WRONG_ADDRESS) ||
+         (length == CLIENT_ERROR_WRONG_DATA))
+    count += (length >= 0);
 
-  uint8_t* digest = (uint8_t*)alloca(SHA256_DIGEST_LENGTH);
+  if ((errno != EAGAIN) &&
+      (errno != EWOULDBLOCK) &&
+      (errno != EINTR))
+    return CLIENT_ERROR_SOCKET_IO;
 
-  struct RewindConfigurationData data;
+  return count;
+}
 
-  // Resolve server IP address
+int CheckRewindLiveness(struct RewindContext* context)
+{
+  struct RewindProbe* probe = context->probes + REWIND_PROBE_KEEP_ALIVE;
+  uint64_t now;
+
+  if (probe->time == 0)
+    return CLIENT_ERROR_SUCCESS;
+
+  now = GetClockTime(context->clock);
+
+  if ((now - probe->time) < GetRewindProbeTimeout(context))
+    return CLIENT_ERROR_SUCCESS;
+
+  // Keep-alive is overdue, probe again right away instead of waiting for the next regular one
+
+  __atomic_store_n(&context->session.lost, context->session.lost + 1, __ATOMIC_RELAXED);
+  context->session.missed ++;
+
+  if ((context->liveness > 0) &&
+      (context->session.missed >= context->liveness))
+    return CLIENT_ERROR_RESPONSE_TIMEOUT;
+
+  TransmitRewindData(context, REWIND_TYPE_KEEP_ALIVE, REWIND_FLAG_NONE, context->data, context->length);
+  return CLIENT_ERROR_SUCCESS;
+}
+
+int ResolveRewindAddress(struct RewindContext* context, const char* location, const char* port)
+{
+  struct addrinfo hints;
 
   if (context->address != NULL)
   {
     freeaddrinfo(context->address);
     context->address = NULL;
+    context->message.msg_name    = NULL;
+    context->message.msg_namelen = 0;
   }
 
   memset(&hints, 0, sizeof(hints));
@@ -237,18 +472,66 @@ int ConnectRewindClient(struct RewindContext* context, const char* location, con
   if (getaddrinfo(location, port, &hints, &context->address) != 0)
     return CLIENT_ERROR_DNS_RESOLVE;
 
+  context->message.msg_name    = context->address->ai_addr;
+  context->message.msg_namelen = context->address->ai_addrlen;
+
+  // Start a new login, probes of the previous server are meaningless
+
+  memset(context->probes, 0, sizeof(context->probes));
+  context->session.missed = 0;
+
+  return CLIENT_ERROR_SUCCESS;
+}
+
+size_t DigestRewindChallenge(uint8_t* digest, struct RewindData* buffer, ssize_t length, const char* password)
+{
+  length -= sizeof(struct RewindData);
+  length += sprintf(buffer->data + length, "%s", password);
+  SHA256(buffer->data, length, digest);
+  return SHA256_DIGEST_LENGTH;
+}
+
+void AnswerRewindChallenge(struct RewindContext* context, struct RewindData* buffer, ssize_t length, const char* password)
+{
+  uint8_t digest[REWIND_DIGEST_SIZE];
+
+  length = DigestRewindChallenge(digest, buffer, length, password);
+  TransmitRewindData(context, REWIND_TYPE_AUTHENTICATION, REWIND_FLAG_NONE, digest, length);
+  __atomic_store_n(&context->session.logins, context->session.logins + 1, __ATOMIC_RELAXED);
+}
+
+int ConnectRewindClient(struct RewindContext* context, const char* location, const char* port, const char* password, uint32_t options)
+{
+  struct RewindData* buffer = (struct RewindData*)alloca(BUFFER_SIZE);
+  ssize_t length;
+  int result;
+
+  size_t attempt = 0;
+  uint64_t now;
+  uint64_t start;
+  uint64_t threshold;
+
+  struct RewindConfigurationData data;
+
+  // Resolve server IP address
+
+  result = ResolveRewindAddress(context, location, port);
+
+  if (result != CLIENT_ERROR_SUCCESS)
+    return result;
+
   // Do login procedure
 
-  gettimeofday(&now, NULL);
-  threshold.tv_sec  = now.tv_sec + CONNECT_TIMEOUT;
-  threshold.tv_usec = now.tv_usec; 
+  now = GetClockTime(context->clock);
+  start = now;
+  threshold = now + CONNECT_TIMEOUT * NANOSECONDS_PER_SECOND;
 
-  while (timercmp(&now, &threshold, <))
+  while (now < threshold)
   {
     TransmitRewindData(context, REWIND_TYPE_KEEP_ALIVE, REWIND_FLAG_NONE, context->data, context->length);
     length = ReceiveRewindData(context, buffer, BUFFER_SIZE);
 
-    gettimeofday(&now, NULL);
+    now = GetClockTime(context->clock);
 
     if ((length == CLIENT_ERROR_WRONG_ADDRESS) ||
         (length == CLIENT_ERROR_SOCKET_IO) &&
@@ -264,10 +547,7 @@ int ConnectRewindClient(struct RewindContext* context, const char* location, con
       case REWIND_TYPE_CHALLENGE:
         if (attempt < ATTEMPT_COUNT)
         {
-          length -= sizeof(struct RewindData);
-          length += sprintf(buffer->data + length, "%s", password);
-          SHA256(buffer->data, length, digest);
-          TransmitRewindData(context, REWIND_TYPE_AUTHENTICATION, REWIND_FLAG_NONE, digest, SHA256_DIGEST_LENGTH);
+          AnswerRewindChallenge(context, buffer, length, password);
           attempt ++;
           continue;
         }
@@ -282,6 +562,7 @@ int ConnectRewindClient(struct RewindContext* context, const char* location, con
         }
 
       case REWIND_TYPE_CONFIGURATION:
+        __atomic_store_n(&context->session.latency, now - start, __ATOMIC_RELAXED);
         return CLIENT_ERROR_SUCCESS;
     }
   }
@@ -289,41 +570,45 @@ int ConnectRewindClient(struct RewindContext* context, const char* location, con
   return CLIENT_ERROR_RESPONSE_TIMEOUT;
 }
 
-int WaitForRewindSessionEnd(struct RewindContext* context, struct RewindSessionPollData* request, time_t interval1, time_t interval2)
+static int PollRewindSessionState(struct RewindContext* context, struct RewindSessionPollData* request, time_t interval1, time_t interval2)
 {
   struct RewindData* buffer = (struct RewindData*)alloca(BUFFER_SIZE);
   struct RewindSessionPollData* response = (struct RewindSessionPollData*)buffer->data;
   ssize_t length;
 
   uint32_t state = 0b00;
-  struct timeval now;
-  struct timeval threshold1;
-  struct timeval threshold2;
+  uint64_t now;
+  uint64_t threshold1;
+  uint64_t threshold2;
 
   if (interval1 < RECEIVE_TIMEOUT)
     interval1 = RECEIVE_TIMEOUT;
 
-  gettimeofday(&now, NULL);
-
-  threshold1.tv_sec  = now.tv_sec + interval1 + interval2;
-  threshold1.tv_usec = now.tv_usec; 
+  now = GetClockTime(context->clock);
 
-  threshold2.tv_sec  = 0;
-  threshold2.tv_usec = 0;
+  threshold1 = now + (interval1 + interval2) * NANOSECONDS_PER_SECOND;
+  threshold2 = 0;
 
-  while (timercmp(&now, &threshold1, <))
+  while (now < threshold1)
   {
     TransmitRewindData(context, REWIND_TYPE_KEEP_ALIVE, REWIND_FLAG_NONE, context->data, context->length);
     TransmitRewindData(context, REWIND_TYPE_SESSION_POLL, REWIND_FLAG_NONE, request, sizeof(struct RewindSessionPollData));
 
     length = ReceiveRewindData(context, buffer, BUFFER_SIZE);
 
-    gettimeofday(&now, NULL);
+    now = GetClockTime(context->clock);
 
-    if ((length == CLIENT_ERROR_WRONG_ADDRESS) ||
-        (length == CLIENT_ERROR_SOCKET_IO) &&
+    if ((length == CLIENT_ERROR_SOCKET_IO) &&
         ((errno == EWOULDBLOCK) ||
          (errno == EAGAIN)))
+    {
+      // Nothing came back within the receive timeout
+      __atomic_store_n(&context->session.lost,    context->session.lost    + (context->probes[REWIND_PROBE_KEEP_ALIVE].time != 0),   __ATOMIC_RELAXED);
+      __atomic_store_n(&context->session.expired, context->session.expired + (context->probes[REWIND_PROBE_SESSION_POLL].time != 0), __ATOMIC_RELAXED);
+      continue;
+    }
+
+    if (length == CLIENT_ERROR_WRONG_ADDRESS)
       continue;
 
     if (length < 0)
@@ -336,20 +621,18 @@ int WaitForRewindSessionEnd(struct RewindContext* context, struct RewindSessionP
         break;
 
       case REWIND_TYPE_SESSION_POLL:
-        if ((response->state   == 0) &&
-            (threshold2.tv_sec == 0))
+        if ((response->state == 0) &&
+            (threshold2      == 0))
         {
-          threshold2.tv_sec  = now.tv_sec + interval2;
-          threshold2.tv_usec = now.tv_usec;
+          threshold2 = now + interval2 * NANOSECONDS_PER_SECOND;
         }
-        if ((response->state   != 0) &&
-            (threshold2.tv_sec != 0))
+        if ((response->state != 0) &&
+            (threshold2      != 0))
         {
-          threshold2.tv_sec  = 0;
-          threshold2.tv_usec = 0;
+          threshold2 = 0;
         }
-        if ((threshold2.tv_sec != 0) &&
-            (timercmp(&now, &threshold2, >)))
+        if ((threshold2 != 0) &&
+            (now > threshold2))
         {
           // No active sessions during <interval2>
           return CLIENT_ERROR_SUCCESS;
@@ -362,10 +645,19 @@ int WaitForRewindSessionEnd(struct RewindContext* context, struct RewindSessionP
     {
       // Got REWIND_TYPE_KEEP_ALIVE and REWIND_TYPE_SESSION_POLL
       // Wait for 2 seconds before the next attempt
-      sleep(RECEIVE_TIMEOUT);
+      SleepClock(context->clock, RECEIVE_TIMEOUT * NANOSECONDS_PER_SECOND);
       state = 0b00;
     }
   }
 
   return CLIENT_ERROR_RESPONSE_TIMEOUT;
 }
+
+int WaitForRewindSessionEnd(struct RewindContext* context, struct RewindSessionPollData* request, time_t interval1, time_t interval2)
+{
+  uint64_t start = GetClockTime(context->clock);
+  int result = PollRewindSessionState(context, request, interval1, interval2);
+
+  __atomic_store_n(&context->session.waiting, context->session.waiting + GetClockTime(context->clock) - start, __ATOMIC_RELAXED);
+  return result;
+}
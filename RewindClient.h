@@ -7,14 +7,18 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <netinet/ip.h>
+#include <sys/socket.h>
 
 #include "Rewind.h"
+#include "Clock.h"
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+struct Trace;
+
 #define SESSION_TYPE_FLAG_GROUP       (1 << 1)
 
 #define SESSION_TYPE_PRIVATE_VOICE    5
@@ -23,6 +27,8 @@ extern "C"
 #define TREE_SESSION_BY_SOURCE        8
 #define TREE_SESSION_BY_TARGET        9
 
+#define REWIND_DIGEST_SIZE            32
+
 #define CLIENT_ERROR_SUCCESS           0
 #define CLIENT_ERROR_SOCKET_IO         -1
 #define CLIENT_ERROR_WRONG_ADDRESS     -2
@@ -30,6 +36,51 @@ extern "C"
 #define CLIENT_ERROR_DNS_RESOLVE       -4
 #define CLIENT_ERROR_WRONG_PASSWORD    -5
 #define CLIENT_ERROR_RESPONSE_TIMEOUT  -6
+#define CLIENT_ERROR_SHORT_SEND        -7
+
+struct RewindSendStatistics
+{
+  uint64_t packets;    // Packets accepted by the kernel
+  uint64_t failures;   // Packets refused by the kernel
+  uint64_t shorts;     // Packets accepted partially
+  uint64_t congestion; // Failures caused by ENOBUFS or EAGAIN
+  uint64_t retries;    // Attempts repeated by retry policy
+  int error;           // Last errno of a failed send
+  int buffer;          // Effective SO_SNDBUF size
+  int queue;           // Last sampled send queue depth (SIOCOUTQ)
+  int peak;            // Highest sampled send queue depth
+};
+
+struct RewindSessionStatistics
+{
+  uint64_t keepalives;  // Keep-alive packets sent
+  uint64_t answers;     // Keep-alive answers received
+  uint64_t logins;      // Authentication attempts
+  uint64_t latency;     // Duration of the last successful login in nanoseconds
+  uint64_t waiting;     // Time spent in WaitForRewindSessionEnd in nanoseconds
+  uint64_t rtt;         // Last round-trip time of a keep-alive or session poll in nanoseconds
+  uint64_t smoothed;    // Smoothed round-trip time
+  uint64_t variation;   // Round-trip time variation
+  uint64_t lost;        // Keep-alives not answered within the probe timeout
+  uint64_t polls;       // Session polls sent
+  uint64_t expired;     // Session polls not answered within the receive timeout
+  uint32_t missed;      // Probes lost since the last answer
+  uint64_t answered;    // Time of the last packet received from the server
+};
+
+// Outstanding keep-alive or session poll, <count> is the number of sends since the last answer,
+// only unambiguous pairs (count 1) are taken as round-trip samples
+
+struct RewindProbe
+{
+  uint64_t time;
+  uint32_t count;
+};
+
+#define REWIND_RETRY_LIMIT         40000  // Longest retry budget in microseconds, well within one 60 ms packet tick
+
+#define REWIND_PROBE_KEEP_ALIVE    0
+#define REWIND_PROBE_SESSION_POLL  1
 
 struct RewindContext
 {
@@ -40,13 +91,49 @@ struct RewindContext
 
   struct RewindVersionData* data;
   size_t length;
+
+  // Prebuilt packet template, only type, flags, number and length are patched per packet
+  struct RewindData header;
+  struct iovec vectors[2];
+  struct msghdr message;
+
+  // Send health, retry budget is in microseconds (0 to drop on the first failure, at most REWIND_RETRY_LIMIT)
+  struct RewindSendStatistics transmission;
+  uint32_t retry;
+
+  struct RewindSessionStatistics session;
+  struct RewindProbe probes[2];
+
+  // Consecutive lost probes to consider the server dead (0 to disable)
+  uint32_t liveness;
+
+  // Time source for timeouts and pauses, NULL for real time
+  struct Clock* clock;
+
+  // Packet trace of every header sent and received, NULL to disable
+  struct Trace* trace;
 };
 
 struct RewindContext* CreateRewindContext(uint32_t number, const char* verion);
 void ReleaseRewindContext(struct RewindContext* context);
 
-void TransmitRewindData(struct RewindContext* context, uint16_t type, uint16_t flag, void* data, size_t length);
+struct msghdr* PrepareRewindData(struct RewindContext* context, uint16_t type, uint16_t flag, void* data, size_t length);
+ssize_t TransmitRewindData(struct RewindContext* context, uint16_t type, uint16_t flag, void* data, size_t length);
+int SampleRewindSendQueue(struct RewindContext* context);
 ssize_t ReceiveRewindData(struct RewindContext* context, struct RewindData* buffer, ssize_t length);
+ssize_t FetchRewindData(struct RewindContext* context, struct RewindData* buffer, ssize_t length);
+
+// Non-blocking counterparts for the playback loop: drain answers, then re-probe or report a dead server
+int ProcessRewindData(struct RewindContext* context);
+int CheckRewindLiveness(struct RewindContext* context);
+
+// Steps of ConnectRewindClient for callers that run their own event loop,
+// <buffer> of challenge must have room to append the password
+int ResolveRewindAddress(struct RewindContext* context, const char* location, const char* port);
+void AnswerRewindChallenge(struct RewindContext* context, struct RewindData* buffer, ssize_t length, const char* password);
+
+// Hashes challenge and password into <digest> of REWIND_DIGEST_SIZE bytes, returns its length
+size_t DigestRewindChallenge(uint8_t* digest, struct RewindData* buffer, ssize_t length, const char* password);
 
 int ConnectRewindClient(struct RewindContext* context, const char* location, const char* port, const char* password, uint32_t options);
 int WaitForRewindSessionEnd(struct RewindContext* context, struct RewindSessionPollData* request, time_t interval1, time_t interval2);
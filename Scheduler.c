@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+
+#include "Scheduler.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "Clock.h"
+
+static int TakeSchedulerTask(struct SchedulerShard* shard, struct SchedulerTask* task)
+{
+  int result = 0;
+
+  pthread_mutex_lock(&shard->lock);
+  if (shard->head != shard->tail)
+  {
+    *task = shard->queue[shard->head % SCHEDULER_QUEUE_LENGTH];
+    shard->head ++;
+    result = 1;
+  }
+  pthread_mutex_unlock(&shard->lock);
+
+  return result;
+}
+
+static int StealSchedulerTask(struct SchedulerShard* shard, struct SchedulerTask* task)
+{
+  struct SchedulerPool* pool = shard->pool;
+  size_t index;
+
+  // Walk the other shards starting from the nearest neighbour so thieves do not all hit shard 0
+
+  for (index = 1; index < pool->count; index ++)
+    if (TakeSchedulerTask(pool->shards + (shard->index + index) % pool->count, task))
+    {
+      __atomic_store_n(&shard->statistics.stolen, shard->statistics.stolen + 1, __ATOMIC_RELAXED);
+      return 1;
+    }
+
+  return 0;
+}
+
+static void DispatchSchedulerStream(struct SchedulerShard* shard, struct SchedulerStream* stream)
+{
+  struct SchedulerStatistics* statistics = &shard->statistics;
+  uint64_t now;
+  uint64_t latency;
+  uint32_t weight;
+  int handle;
+
+  now = GetClockTime(NULL);
+
+  // Streams also wake up for socket data, only a due timer counts as a tick
+
+  if ((stream->due != 0) &&
+      (stream->due <= now))
+  {
+    latency = now - stream->due;
+
+    __atomic_store_n(&statistics->ticks,   statistics->ticks   + 1,                                    __ATOMIC_RELAXED);
+    __atomic_store_n(&statistics->late,    statistics->late    + (latency > SCHEDULER_LATE_THRESHOLD), __ATOMIC_RELAXED);
+    __atomic_store_n(&statistics->latency, statistics->latency + latency,                              __ATOMIC_RELAXED);
+
+    if (statistics->maximum < latency)
+      __atomic_store_n(&statistics->maximum, latency, __ATOMIC_RELAXED);
+  }
+
+  // Stream may be released by its owner as soon as it is detached, so nothing is read from it afterwards
+
+  handle = stream->handle;
+  weight = stream->weight;
+
+  if (stream->handler(stream) < 0)
+  {
+    epoll_ctl(shard->handle, EPOLL_CTL_DEL, handle, NULL);
+    __atomic_fetch_sub(&statistics->streams, 1,      __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&statistics->load,    weight, __ATOMIC_RELAXED);
+    __atomic_store_n(&stream->shard, NULL, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&statistics->work, statistics->work + GetClockTime(NULL) - now, __ATOMIC_RELAXED);
+}
+
+static void* ExecuteSchedulerShard(void* argument)
+{
+  struct SchedulerShard* shard = (struct SchedulerShard*)argument;
+  struct SchedulerPool* pool = shard->pool;
+  struct SchedulerStatistics* statistics = &shard->statistics;
+  struct epoll_event events[SCHEDULER_EVENT_COUNT];
+  struct SchedulerTask task;
+  uint64_t value;
+  uint64_t now;
+  int timeout = -1;
+  int count;
+  int index;
+
+  cpu_set_t set;
+
+  if (shard->processor >= 0)
+  {
+    CPU_ZERO(&set);
+    CPU_SET(shard->processor, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+  }
+
+  while (__atomic_load_n(&pool->state, __ATOMIC_ACQUIRE) != 0)
+  {
+    count = epoll_wait(shard->handle, events, SCHEDULER_EVENT_COUNT, timeout);
+
+    for (index = 0; index < count; index ++)
+    {
+      if (events[index].data.ptr == NULL)
+      {
+        read(shard->event, &value, sizeof(uint64_t));
+        continue;
+      }
+
+      DispatchSchedulerStream(shard, (struct SchedulerStream*)events[index].data.ptr);
+    }
+
+    // One task at a time between polls keeps due streams of this shard waiting for at most one task
+
+    timeout = -1;
+
+    if ((__atomic_load_n(&pool->state, __ATOMIC_ACQUIRE) != 0) &&
+        (TakeSchedulerTask(shard, &task) ||
+         StealSchedulerTask(shard, &task)))
+    {
+      now = GetClockTime(NULL);
+      task.handler(task.data);
+      __atomic_store_n(&statistics->tasks, statistics->tasks + 1, __ATOMIC_RELAXED);
+      __atomic_store_n(&statistics->work,  statistics->work + GetClockTime(NULL) - now, __ATOMIC_RELAXED);
+      timeout = 0;
+    }
+  }
+
+  return NULL;
+}
+
+struct SchedulerPool* CreateSchedulerPool(size_t count)
+{
+  struct SchedulerPool* pool;
+  struct SchedulerShard* shard;
+  struct epoll_event event;
+  int processors[CPU_SETSIZE];
+  int number = 0;
+  int value;
+  size_t index;
+
+  cpu_set_t set;
+
+  // Shards are pinned round-robin to the CPUs this process is allowed to use
+
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == 0)
+    for (value = 0; value < CPU_SETSIZE; value ++)
+      if (CPU_ISSET(value, &set))
+        processors[number ++] = value;
+
+  if (count == 0)
+    count = (number > 0) ? number : 1;
+
+  pool = (struct SchedulerPool*)calloc(1, sizeof(struct SchedulerPool));
+
+  if (pool == NULL)
+    return NULL;
+
+  pool->shards = (struct SchedulerShard*)calloc(count, sizeof(struct SchedulerShard));
+
+  if (pool->shards == NULL)
+  {
+    free(pool);
+    return NULL;
+  }
+
+  pool->state = 1;
+
+  for (index = 0; index < count; index ++)
+  {
+    shard = pool->shards + index;
+
+    shard->pool      = pool;
+    shard->index     = index;
+    shard->processor = (number > 0) ? processors[index % number] : -1;
+    shard->handle    = epoll_create1(EPOLL_CLOEXEC);
+    shard->event     = eventfd(0, EFD_NONBLOCK);
+
+    pthread_mutex_init(&shard->lock, NULL);
+
+    event.events   = EPOLLIN;
+    event.data.ptr = NULL;
+
+    if ((shard->handle < 0) ||
+        (shard->event < 0) ||
+        (epoll_ctl(shard->handle, EPOLL_CTL_ADD, shard->event, &event) < 0) ||
+        (pthread_create(&shard->thread, NULL, ExecuteSchedulerShard, shard) != 0))
+    {
+      close(shard->handle);
+      close(shard->event);
+      pthread_mutex_destroy(&shard->lock);
+      break;
+    }
+
+    pool->count ++;
+  }
+
+  if (pool->count < count)
+  {
+    ReleaseSchedulerPool(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+void ReleaseSchedulerPool(struct SchedulerPool* pool)
+{
+  struct SchedulerShard* shard;
+  uint64_t value = 1;
+  size_t index;
+
+  if (pool != NULL)
+  {
+    __atomic_store_n(&pool->state, 0, __ATOMIC_RELEASE);
+
+    for (index = 0; index < pool->count; index ++)
+    {
+      shard = pool->shards + index;
+      write(shard->event, &value, sizeof(uint64_t));
+      pthread_join(shard->thread, NULL);
+      close(shard->handle);
+      close(shard->event);
+      pthread_mutex_destroy(&shard->lock);
+    }
+
+    free(pool->shards);
+    free(pool);
+  }
+}
+
+static struct SchedulerShard* FindSchedulerShard(struct SchedulerPool* pool)
+{
+  struct SchedulerShard* shard = NULL;
+  struct SchedulerShard* candidate;
+  uint32_t load1 = 0;
+  uint32_t load2;
+  uint32_t streams1 = 0;
+  uint32_t streams2;
+  size_t index;
+
+  // Least loaded shard, ties are broken by stream count
+
+  for (index = 0; index < pool->count; index ++)
+  {
+    candidate = pool->shards + index;
+    load2     = __atomic_load_n(&candidate->statistics.load,    __ATOMIC_RELAXED);
+    streams2  = __atomic_load_n(&candidate->statistics.streams, __ATOMIC_RELAXED);
+
+    if ((shard == NULL) ||
+        (load2 < load1) ||
+        ((load2 == load1) &&
+         (streams2 < streams1)))
+    {
+      shard    = candidate;
+      load1    = load2;
+      streams1 = streams2;
+    }
+  }
+
+  return shard;
+}
+
+int AttachSchedulerStream(struct SchedulerPool* pool, struct SchedulerStream* stream)
+{
+  struct SchedulerShard* shard;
+  struct epoll_event event;
+
+  if (stream->weight == 0)
+    stream->weight = 1;
+
+  shard = FindSchedulerShard(pool);
+
+  if (shard == NULL)
+    return SCHEDULER_ERROR_NO_SHARD;
+
+  stream->shard = shard;
+
+  __atomic_fetch_add(&shard->statistics.streams, 1,              __ATOMIC_RELAXED);
+  __atomic_fetch_add(&shard->statistics.load,    stream->weight, __ATOMIC_RELAXED);
+
+  // The shard may call the handler at once, everything above is set up already
+
+  event.events   = EPOLLIN;
+  event.data.ptr = stream;
+
+  if (epoll_ctl(shard->handle, EPOLL_CTL_ADD, stream->handle, &event) < 0)
+  {
+    __atomic_fetch_sub(&shard->statistics.streams, 1,              __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&shard->statistics.load,    stream->weight, __ATOMIC_RELAXED);
+    stream->shard = NULL;
+    return SCHEDULER_ERROR_HANDLE;
+  }
+
+  return SCHEDULER_ERROR_SUCCESS;
+}
+
+int SubmitSchedulerTask(struct SchedulerPool* pool, SchedulerTaskHandler handler, void* data)
+{
+  struct SchedulerShard* shard;
+  uint64_t value = 1;
+  size_t index;
+
+  // Queue the task on the least loaded shard, idle shards will steal it if that one is busy
+
+  shard = FindSchedulerShard(pool);
+
+  if (shard == NULL)
+    return SCHEDULER_ERROR_NO_SHARD;
+
+  pthread_mutex_lock(&shard->lock);
+  if ((shard->tail - shard->head) >= SCHEDULER_QUEUE_LENGTH)
+  {
+    pthread_mutex_unlock(&shard->lock);
+    return SCHEDULER_ERROR_QUEUE_FULL;
+  }
+  shard->queue[shard->tail % SCHEDULER_QUEUE_LENGTH].handler = handler;
+  shard->queue[shard->tail % SCHEDULER_QUEUE_LENGTH].data    = data;
+  shard->tail ++;
+  pthread_mutex_unlock(&shard->lock);
+
+  // Wake up every shard, the first idle one takes the task
+
+  for (index = 0; index < pool->count; index ++)
+    write(pool->shards[index].event, &value, sizeof(uint64_t));
+
+  return SCHEDULER_ERROR_SUCCESS;
+}
+
+void GetSchedulerStatistics(struct SchedulerPool* pool, size_t index, struct SchedulerStatistics* statistics)
+{
+  struct SchedulerStatistics* source = &pool->shards[index].statistics;
+
+  statistics->ticks   = __atomic_load_n(&source->ticks,   __ATOMIC_RELAXED);
+  statistics->late    = __atomic_load_n(&source->late,    __ATOMIC_RELAXED);
+  statistics->latency = __atomic_load_n(&source->latency, __ATOMIC_RELAXED);
+  statistics->maximum = __atomic_load_n(&source->maximum, __ATOMIC_RELAXED);
+  statistics->work    = __atomic_load_n(&source->work,    __ATOMIC_RELAXED);
+  statistics->tasks   = __atomic_load_n(&source->tasks,   __ATOMIC_RELAXED);
+  statistics->stolen  = __atomic_load_n(&source->stolen,  __ATOMIC_RELAXED);
+  statistics->streams = __atomic_load_n(&source->streams, __ATOMIC_RELAXED);
+  statistics->load    = __atomic_load_n(&source->load,    __ATOMIC_RELAXED);
+}
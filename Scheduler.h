@@ -0,0 +1,109 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SCHEDULER_QUEUE_LENGTH     256
+#define SCHEDULER_EVENT_COUNT      64
+#define SCHEDULER_LATE_THRESHOLD   (5 * 1000000ULL)  // Tick latency counted as late, in nanoseconds
+
+#define SCHEDULER_ERROR_SUCCESS     0
+#define SCHEDULER_ERROR_NO_SHARD   -1
+#define SCHEDULER_ERROR_QUEUE_FULL -2
+#define SCHEDULER_ERROR_HANDLE     -3
+
+struct SchedulerShard;
+struct SchedulerStream;
+
+// Stream handler runs on the shard thread whenever <handle> is readable and returns
+// a negative value to detach the stream. The shard clears <shard> once it no longer
+// touches the stream, only then the owner may release it.
+typedef int (*SchedulerStreamHandler)(struct SchedulerStream* stream);
+typedef void (*SchedulerTaskHandler)(void* data);
+
+struct SchedulerStream
+{
+  struct SchedulerShard* shard;
+
+  int handle;       // Descriptor polled for reading, such as GetPlayerHandle
+  SchedulerStreamHandler handler;
+  void* data;
+
+  uint32_t weight;  // Relative cost of the stream, used for placement
+  uint64_t due;     // Next timer expiry set by the owner and the handler, 0 if none
+};
+
+struct SchedulerTask
+{
+  SchedulerTaskHandler handler;
+  void* data;
+};
+
+// Written by the shard thread and by placement with atomics, read with GetSchedulerStatistics
+
+struct SchedulerStatistics
+{
+  uint64_t ticks;     // Dispatches of streams whose timer was due
+  uint64_t late;      // Ticks dispatched more than SCHEDULER_LATE_THRESHOLD after they were due
+  uint64_t latency;   // Sum of tick latencies in nanoseconds
+  uint64_t maximum;   // Worst tick latency in nanoseconds
+  uint64_t work;      // Time spent in stream handlers and tasks in nanoseconds
+  uint64_t tasks;     // Tasks executed by this shard
+  uint64_t stolen;    // Tasks taken from other shards
+  uint32_t streams;   // Attached streams
+  uint32_t load;      // Sum of stream weights
+};
+
+// Each shard is a thread pinned to one CPU that waits on its own epoll set of stream
+// descriptors, so sockets and timers of a stream are only ever served by its shard
+
+struct SchedulerShard
+{
+  struct SchedulerPool* pool;
+  size_t index;
+  int processor;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+
+  int handle;  // epoll
+  int event;   // eventfd to wake up the worker
+
+  struct SchedulerTask queue[SCHEDULER_QUEUE_LENGTH];
+  size_t head;
+  size_t tail;
+
+  struct SchedulerStatistics statistics;
+};
+
+struct SchedulerPool
+{
+  int state;
+  size_t count;
+  struct SchedulerShard* shards;
+};
+
+// <count> of 0 starts one shard per CPU the process may run on
+struct SchedulerPool* CreateSchedulerPool(size_t count);
+void ReleaseSchedulerPool(struct SchedulerPool* pool);
+
+// Places the stream on the shard with the least load
+int AttachSchedulerStream(struct SchedulerPool* pool, struct SchedulerStream* stream);
+
+// Queues bursty work such as opening input or login, idle shards steal it from busy ones
+int SubmitSchedulerTask(struct SchedulerPool* pool, SchedulerTaskHandler handler, void* data);
+
+void GetSchedulerStatistics(struct SchedulerPool* pool, size_t index, struct SchedulerStatistics* statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,431 @@
+#include "SessionTable.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <unistd.h>
+#include <endian.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+
+#define BUFFER_SIZE    256
+#define RECEIVE_SIZE   (BUFFER_SIZE / 2)
+#define EVENT_COUNT    64
+#define MISSED_LIMIT   3
+
+#define ALIGN(value)   (((value) + 7) & ~7)
+
+// Timer wheel
+
+static void ScheduleSession(struct SessionTable* table, uint32_t index, uint32_t deadline)
+{
+  uint32_t slot = deadline & (SESSION_WHEEL_LENGTH - 1);
+
+  table->deadlines[index] = deadline;
+  table->backlinks[index] = SESSION_NONE;
+  table->links[index]     = table->wheel[slot];
+
+  if (table->wheel[slot] != SESSION_NONE)
+    table->backlinks[table->wheel[slot]] = index;
+
+  table->wheel[slot] = index;
+}
+
+static void UnscheduleSession(struct SessionTable* table, uint32_t index)
+{
+  uint32_t next     = table->links[index];
+  uint32_t previous = table->backlinks[index];
+
+  if (previous != SESSION_NONE)
+    table->links[previous] = next;
+  else
+    table->wheel[table->deadlines[index] & (SESSION_WHEEL_LENGTH - 1)] = next;
+
+  if (next != SESSION_NONE)
+    table->backlinks[next] = previous;
+}
+
+// Transmission
+
+static void TransmitSessionData(struct SessionTable* table, uint32_t index, uint16_t type, void* data, size_t length)
+{
+  struct RewindData header;
+  struct iovec vectors[3];
+  struct msghdr message;
+
+  memset(&message, 0, sizeof(struct msghdr));
+  memcpy(header.sign, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH);
+
+  vectors[0].iov_base = &header;
+  vectors[0].iov_len  = sizeof(struct RewindData);
+  vectors[1].iov_base = data;
+  vectors[1].iov_len  = length;
+
+  message.msg_name    = table->locations + table->addresses[index];
+  message.msg_namelen = sizeof(struct sockaddr_in6);
+  message.msg_iov     = vectors;
+  message.msg_iovlen  = 2;
+
+  if (type == REWIND_TYPE_KEEP_ALIVE)
+  {
+    // Number of the client followed by version data shared by all sessions
+
+    vectors[1].iov_base = table->numbers + index;
+    vectors[1].iov_len  = sizeof(uint32_t);
+    vectors[2].iov_base = table->payload;
+    vectors[2].iov_len  = table->length;
+
+    length = sizeof(uint32_t) + table->length;
+    message.msg_iovlen = 3;
+  }
+
+  header.type   = htole16(type);
+  header.flags  = htole16(REWIND_FLAG_NONE);
+  header.number = htole32(table->counters[index]);
+  header.length = htole16(length);
+
+  table->counters[index] ++;
+
+  if (sendmsg(table->handles[index], &message, MSG_DONTWAIT) < 0)
+    table->statistics.failures ++;
+}
+
+static void TransmitSessionProbe(struct SessionTable* table, uint32_t index)
+{
+  struct RewindSessionPollData request;
+
+  TransmitSessionData(table, index, REWIND_TYPE_KEEP_ALIVE, NULL, 0);
+  table->statistics.keepalives ++;
+
+  if (table->groups[index] != 0)
+  {
+    request.type   = htole32(TREE_SESSION_BY_TARGET);
+    request.flag   = htole32(SESSION_TYPE_FLAG_GROUP);
+    request.number = htole32(table->groups[index]);
+    request.state  = 0;
+
+    TransmitSessionData(table, index, REWIND_TYPE_SESSION_POLL, &request, sizeof(struct RewindSessionPollData));
+    table->statistics.polls ++;
+  }
+
+  // Server has to log the session in again after a few unanswered keep-alives
+
+  if ((++ table->missed[index]) > MISSED_LIMIT)
+    table->phases[index] = SESSION_STATE_CONNECTING;
+}
+
+// Table
+
+struct SessionTable* CreateSessionTable(size_t capacity, const char* version, const char* password)
+{
+  struct SessionTable* table;
+  struct utsname name;
+  uint8_t* pointer;
+  size_t size;
+  size_t index;
+
+  // Widest fields go first to keep every array aligned in one allocation
+
+  size  = ALIGN(sizeof(struct SessionTable));
+  size += capacity * sizeof(uint64_t);
+  size += capacity * (sizeof(int) + 7 * sizeof(uint32_t));
+  size += capacity * 3 * sizeof(uint8_t);
+  size += BUFFER_SIZE;
+
+  table = (struct SessionTable*)calloc(1, size);
+
+  if (table == NULL)
+    return NULL;
+
+  pointer = (uint8_t*)table + ALIGN(sizeof(struct SessionTable));
+
+  table->answered  = (uint64_t*)pointer;  pointer += capacity * sizeof(uint64_t);
+  table->handles   = (int*)pointer;       pointer += capacity * sizeof(int);
+  table->numbers   = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->counters  = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->deadlines = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->links     = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->backlinks = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->groups    = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->states    = (uint32_t*)pointer;  pointer += capacity * sizeof(uint32_t);
+  table->addresses = pointer;             pointer += capacity;
+  table->phases    = pointer;             pointer += capacity;
+  table->missed    = pointer;             pointer += capacity;
+  table->payload   = pointer;
+
+  table->capacity = capacity;
+  table->size     = size;
+  table->password = password;
+  table->interval = REWIND_KEEP_ALIVE_INTERVAL * NANOSECONDS_PER_SECOND / SESSION_WHEEL_RESOLUTION;
+  table->period   = SESSION_POLL_INTERVAL * NANOSECONDS_PER_SECOND / SESSION_WHEEL_RESOLUTION;
+  table->handle   = epoll_create1(EPOLL_CLOEXEC);
+
+  if (table->handle < 0)
+  {
+    free(table);
+    return NULL;
+  }
+
+  // All slots are free, linked in order
+
+  for (index = 0; index < capacity; index ++)
+    table->links[index] = index + 1;
+
+  if (capacity > 0)
+    table->links[capacity - 1] = SESSION_NONE;
+
+  table->unused = (capacity > 0) ? 0 : SESSION_NONE;
+
+  for (index = 0; index < SESSION_WHEEL_LENGTH; index ++)
+    table->wheel[index] = SESSION_NONE;
+
+  // Version data is the same for every session but the number
+
+  uname(&name);
+
+  table->payload[0] = REWIND_SERVICE_SIMPLE_APPLICATION;
+  table->length     = 1 + snprintf((char*)table->payload + 1, BUFFER_SIZE - 1, "%s %s %s", version, name.sysname, name.machine);
+
+  if (table->length >= BUFFER_SIZE)
+    table->length = BUFFER_SIZE - 1;
+
+  return table;
+}
+
+void ReleaseSessionTable(struct SessionTable* table)
+{
+  uint32_t index;
+
+  if (table != NULL)
+  {
+    for (index = 0; index < table->capacity; index ++)
+      if (table->phases[index] != SESSION_STATE_FREE)
+        CloseSession(table, index);
+
+    close(table->handle);
+    free(table);
+  }
+}
+
+int ResolveSessionAddress(struct SessionTable* table, const char* location, const char* port)
+{
+  struct addrinfo hints;
+  struct addrinfo* list;
+  struct sockaddr_in6* address;
+  size_t index;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_family   = AF_INET6;
+  hints.ai_flags    = AI_V4MAPPED;
+
+  if (getaddrinfo(location, port, &hints, &list) != 0)
+    return CLIENT_ERROR_DNS_RESOLVE;
+
+  address = (struct sockaddr_in6*)list->ai_addr;
+
+  for (index = 0; index < table->locationCount; index ++)
+    if ((table->locations[index].sin6_port == address->sin6_port) &&
+        (memcmp(&table->locations[index].sin6_addr, &address->sin6_addr, sizeof(struct in6_addr)) == 0))
+      break;
+
+  if ((index == table->locationCount) &&
+      (index < SESSION_ADDRESS_COUNT))
+  {
+    memcpy(table->locations + index, address, sizeof(struct sockaddr_in6));
+    table->locationCount ++;
+  }
+
+  freeaddrinfo(list);
+
+  return (index < SESSION_ADDRESS_COUNT) ? index : SESSION_TABLE_ERROR_FULL;
+}
+
+ssize_t OpenSession(struct SessionTable* table, uint32_t number, int address, uint64_t now)
+{
+  struct epoll_event event;
+  uint32_t index;
+  int handle;
+
+  if (table->unused == SESSION_NONE)
+    return SESSION_TABLE_ERROR_FULL;
+
+  if ((address < 0) ||
+      (address >= table->locationCount))
+    return SESSION_TABLE_ERROR_ADDRESS;
+
+  index = table->unused;
+
+  event.events   = EPOLLIN;
+  event.data.u32 = index;
+
+  handle = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+
+  if ((handle < 0) ||
+      (epoll_ctl(table->handle, EPOLL_CTL_ADD, handle, &event) < 0))
+  {
+    close(handle);
+    return SESSION_TABLE_ERROR_SOCKET;
+  }
+
+  table->unused = table->links[index];
+  table->count ++;
+
+  table->handles[index]   = handle;
+  table->numbers[index]   = htole32(number);
+  table->counters[index]  = 0;
+  table->groups[index]    = 0;
+  table->states[index]    = SESSION_POLL_UNKNOWN;
+  table->answered[index]  = 0;
+  table->addresses[index] = address;
+  table->phases[index]    = SESSION_STATE_CONNECTING;
+  table->missed[index]    = 0;
+
+  // First keep-alive starts login at once
+
+  TransmitSessionProbe(table, index);
+  ScheduleSession(table, index, now / SESSION_WHEEL_RESOLUTION + table->interval);
+
+  return index;
+}
+
+void CloseSession(struct SessionTable* table, uint32_t index)
+{
+  if (table->phases[index] == SESSION_STATE_FREE)
+    return;
+
+  TransmitSessionData(table, index, REWIND_TYPE_CLOSE, NULL, 0);
+  UnscheduleSession(table, index);
+
+  close(table->handles[index]);
+
+  table->handles[index] = -1;
+  table->phases[index]  = SESSION_STATE_FREE;
+  table->links[index]   = table->unused;
+  table->unused         = index;
+  table->count --;
+}
+
+void PollSessionGroup(struct SessionTable* table, uint32_t index, uint32_t group)
+{
+  table->groups[index] = group;
+  table->states[index] = SESSION_POLL_UNKNOWN;
+
+  // Logged in session gets the first answer at once, others right after login
+
+  if ((group != 0) &&
+      (table->phases[index] == SESSION_STATE_ACTIVE))
+  {
+    UnscheduleSession(table, index);
+    TransmitSessionProbe(table, index);
+    ScheduleSession(table, index, table->tick + table->period);
+  }
+}
+
+size_t AdvanceSessionTable(struct SessionTable* table, uint64_t now)
+{
+  uint64_t tick = now / SESSION_WHEEL_RESOLUTION;
+  uint32_t index;
+  uint32_t next;
+  size_t count = 0;
+
+  // A long stall visits every slot once, sessions keep their phase within the interval
+
+  if ((tick - table->tick) > SESSION_WHEEL_LENGTH)
+    table->tick = tick - SESSION_WHEEL_LENGTH;
+
+  while (table->tick < tick)
+  {
+    table->tick ++;
+
+    for (index = table->wheel[table->tick & (SESSION_WHEEL_LENGTH - 1)]; index != SESSION_NONE; index = next)
+    {
+      next = table->links[index];
+      table->statistics.scanned ++;
+
+      if ((int32_t)(table->deadlines[index] - (uint32_t)table->tick) > 0)
+      {
+        // Due in a later turn of the wheel
+        continue;
+      }
+
+      UnscheduleSession(table, index);
+      TransmitSessionProbe(table, index);
+      ScheduleSession(table, index, table->tick + ((table->groups[index] != 0) ? table->period : table->interval));
+      count ++;
+    }
+  }
+
+  return count;
+}
+
+int ProcessSessionTable(struct SessionTable* table, int timeout, uint64_t now)
+{
+  struct RewindData* buffer = (struct RewindData*)alloca(BUFFER_SIZE);
+  struct RewindSessionPollData* response = (struct RewindSessionPollData*)buffer->data;
+  struct epoll_event events[EVENT_COUNT];
+  struct sockaddr_in6 address;
+  struct sockaddr_in6* location;
+  uint8_t digest[REWIND_DIGEST_SIZE];
+  socklen_t size;
+  ssize_t length;
+  uint32_t index;
+  uint8_t phase;
+  int count;
+  int result = 0;
+
+  count = epoll_wait(table->handle, events, EVENT_COUNT, timeout);
+
+  while ((-- count) >= 0)
+  {
+    index    = events[count].data.u32;
+    location = table->locations + table->addresses[index];
+    size     = sizeof(struct sockaddr_in6);
+
+    // Room is left behind the datagram to append the password to a challenge
+
+    while ((table->phases[index] != SESSION_STATE_FREE) &&
+           ((length = recvfrom(table->handles[index], buffer, RECEIVE_SIZE, MSG_DONTWAIT, (struct sockaddr*)&address, &size)) >= 0))
+    {
+      if ((address.sin6_port != location->sin6_port) ||
+          (memcmp(&address.sin6_addr, &location->sin6_addr, sizeof(struct in6_addr)) != 0) ||
+          (length < sizeof(struct RewindData)) ||
+          (memcmp(buffer->sign, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH) != 0))
+        continue;
+
+      table->answered[index] = now;
+      table->missed[index]   = 0;
+      table->statistics.answers ++;
+      result ++;
+
+      switch (le16toh(buffer->type))
+      {
+        case REWIND_TYPE_CHALLENGE:
+          length = DigestRewindChallenge(digest, buffer, length, table->password);
+          TransmitSessionData(table, index, REWIND_TYPE_AUTHENTICATION, digest, length);
+          table->statistics.logins ++;
+          break;
+
+        case REWIND_TYPE_KEEP_ALIVE:
+          phase = table->phases[index];
+          table->phases[index] = SESSION_STATE_ACTIVE;
+
+          // Poll state is needed as soon as the server accepts the session
+          if ((phase == SESSION_STATE_CONNECTING) &&
+              (table->groups[index] != 0))
+            PollSessionGroup(table, index, table->groups[index]);
+          break;
+
+        case REWIND_TYPE_SESSION_POLL:
+          if (length >= (sizeof(struct RewindData) + sizeof(struct RewindSessionPollData)))
+            table->states[index] = le32toh(response->state);
+          break;
+      }
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,114 @@
+#ifndef SESSIONTABLE_H
+#define SESSIONTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <netinet/in.h>
+#include <sys/types.h>
+
+#include "RewindClient.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SESSION_TABLE_ERROR_SUCCESS    0
+#define SESSION_TABLE_ERROR_FULL      -32
+#define SESSION_TABLE_ERROR_SOCKET    -33
+#define SESSION_TABLE_ERROR_ADDRESS   -34
+
+#define SESSION_STATE_FREE            0
+#define SESSION_STATE_CONNECTING      1
+#define SESSION_STATE_ACTIVE          2
+
+#define SESSION_WHEEL_LENGTH          64                                    // Slots, power of two
+#define SESSION_WHEEL_RESOLUTION      (125 * NANOSECONDS_PER_MILLISECOND)  // Slot width
+#define SESSION_ADDRESS_COUNT         16
+#define SESSION_POLL_INTERVAL         2                                     // Seconds between polls of a TG
+
+#define SESSION_NONE                  UINT32_MAX
+#define SESSION_POLL_UNKNOWN          UINT32_MAX
+
+struct SessionTableStatistics
+{
+  uint64_t keepalives;  // Keep-alive packets sent
+  uint64_t polls;       // Session polls sent
+  uint64_t answers;     // Packets received from servers
+  uint64_t logins;      // Challenges answered
+  uint64_t failures;    // Packets refused by the kernel
+  uint64_t scanned;     // Sessions visited by the timer wheel
+};
+
+// Warm sessions of a daemon kept in one allocation. Every hot field is an array
+// indexed by session, so the timer wheel and the receive path touch only the
+// fields they need. Version data, password and resolved server addresses are
+// shared by all sessions, only the client number differs per session and is
+// sent from its own array as a separate I/O vector.
+
+struct SessionTable
+{
+  size_t capacity;
+  size_t count;
+  size_t size;          // Bytes allocated for the table
+  int handle;           // epoll, event data is the session index
+  uint32_t unused;      // Head of the list of free slots
+
+  // Per-session fields
+  int* handles;
+  uint32_t* numbers;    // Client number, little-endian
+  uint32_t* counters;   // Sequence number of control packets
+  uint32_t* deadlines;  // Next keep-alive, in wheel ticks
+  uint32_t* links;      // Next session in the same wheel slot or in the free list
+  uint32_t* backlinks;  // Previous session in the same wheel slot
+  uint32_t* groups;     // TG to poll with keep-alives, 0 for none
+  uint32_t* states;     // Last session poll state of the TG, SESSION_POLL_UNKNOWN before the first answer
+  uint64_t* answered;   // Time of the last packet received
+  uint8_t* addresses;   // Index of the shared server address
+  uint8_t* phases;      // SESSION_STATE_*
+  uint8_t* missed;      // Keep-alives sent since the last answer
+
+  // Timer wheel
+  uint32_t wheel[SESSION_WHEEL_LENGTH];
+  uint64_t tick;
+  uint32_t interval;    // Keep-alive interval in ticks
+  uint32_t period;      // Interval of sessions that poll a TG, in ticks
+
+  // Shared immutable data
+  struct sockaddr_in6 locations[SESSION_ADDRESS_COUNT];
+  size_t locationCount;
+  const char* password;
+  uint8_t* payload;     // struct RewindVersionData without the number field
+  size_t length;
+
+  struct SessionTableStatistics statistics;
+};
+
+// <password> is not copied and has to outlive the table
+struct SessionTable* CreateSessionTable(size_t capacity, const char* version, const char* password);
+void ReleaseSessionTable(struct SessionTable* table);
+
+// Returns the index of a shared server address, resolving each distinct server once
+int ResolveSessionAddress(struct SessionTable* table, const char* location, const char* port);
+
+// Starts login of a session, its keep-alives are due every REWIND_KEEP_ALIVE_INTERVAL seconds from <now>
+ssize_t OpenSession(struct SessionTable* table, uint32_t number, int address, uint64_t now);
+void CloseSession(struct SessionTable* table, uint32_t index);
+
+// Adds a session poll of <group> to every keep-alive of the session and sends them
+// every SESSION_POLL_INTERVAL seconds instead, 0 to stop
+void PollSessionGroup(struct SessionTable* table, uint32_t index, uint32_t group);
+
+// Sends keep-alives due by <now> and returns the number of sessions served
+size_t AdvanceSessionTable(struct SessionTable* table, uint64_t now);
+
+// Waits up to <timeout> milliseconds for answers, handles login and poll states and
+// returns the number of packets received
+int ProcessSessionTable(struct SessionTable* table, int timeout, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,234 @@
+#include "Simulator.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#ifdef __linux__
+#include <endian.h>
+#endif
+
+#include "Rewind.h"
+
+#define BUFFER_SIZE         256
+#define RECEIVE_TIMEOUT     100000
+#define SYNCHRONIZE_LIMIT   1000
+
+#define SHA256_DIGEST_SIZE  32
+
+#define PHASE_LOGIN         0
+#define PHASE_HEADER        1
+#define PHASE_AUDIO         2
+#define PHASE_TERMINATED    3
+#define PHASE_CLOSED        4
+
+#define REWIND_TYPE_TERMINATOR  (REWIND_TYPE_DMR_DATA_BASE + 2)
+
+static void TransmitSimulatorData(struct Simulator* simulator, struct sockaddr_in6* address, uint16_t type, void* data, size_t length)
+{
+  uint8_t buffer[BUFFER_SIZE];
+  struct RewindData* header = (struct RewindData*)buffer;
+
+  memset(header, 0, sizeof(struct RewindData));
+  memcpy(header->sign, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH);
+
+  header->type   = htole16(type);
+  header->length = htole16(length);
+
+  if (length > 0)
+    memcpy(header->data, data, length);
+
+  sendto(simulator->handle, buffer, sizeof(struct RewindData) + length, 0, (struct sockaddr*)address, sizeof(struct sockaddr_in6));
+}
+
+static void ProcessSimulatorData(struct Simulator* simulator, struct sockaddr_in6* address, struct RewindData* packet, size_t length)
+{
+  struct SimulatorReport* report = &simulator->report;
+  struct RewindSessionPollData* poll;
+  uint32_t number = le32toh(packet->number);
+  size_t index = le16toh(packet->flags) & REWIND_FLAG_REAL_TIME_1;
+  uint32_t nonce;
+
+  report->packets ++;
+
+  if (number != simulator->numbers[index])
+    report->gaps ++;
+
+  simulator->numbers[index] = number + 1;
+
+  switch (le16toh(packet->type))
+  {
+    case REWIND_TYPE_KEEP_ALIVE:
+      report->keepalives ++;
+      simulator->run = 0;
+      if (simulator->authenticated == 0)
+      {
+        nonce = rand();
+        TransmitSimulatorData(simulator, address, REWIND_TYPE_CHALLENGE, &nonce, sizeof(uint32_t));
+        break;
+      }
+      TransmitSimulatorData(simulator, address, REWIND_TYPE_KEEP_ALIVE, NULL, 0);
+      break;
+
+    case REWIND_TYPE_AUTHENTICATION:
+      if (le16toh(packet->length) == SHA256_DIGEST_SIZE)
+      {
+        simulator->authenticated = 1;
+        TransmitSimulatorData(simulator, address, REWIND_TYPE_KEEP_ALIVE, NULL, 0);
+      }
+      break;
+
+    case REWIND_TYPE_CONFIGURATION:
+      TransmitSimulatorData(simulator, address, REWIND_TYPE_CONFIGURATION, packet->data, le16toh(packet->length));
+      break;
+
+    case REWIND_TYPE_SESSION_POLL:
+      // The talkgroup is always idle
+      report->polls ++;
+      poll = (struct RewindSessionPollData*)packet->data;
+      poll->state = 0;
+      TransmitSimulatorData(simulator, address, REWIND_TYPE_SESSION_POLL, poll, sizeof(struct RewindSessionPollData));
+      break;
+
+    case REWIND_TYPE_SUPER_HEADER:
+      report->headers ++;
+      report->order += (simulator->phase > PHASE_HEADER);
+      simulator->phase = PHASE_HEADER;
+      break;
+
+    case REWIND_TYPE_DMR_AUDIO_FRAME:
+      report->frames ++;
+      report->order += (simulator->phase != PHASE_HEADER) && (simulator->phase != PHASE_AUDIO);
+      simulator->phase = PHASE_AUDIO;
+      simulator->run ++;
+      if (report->cadence < simulator->run)
+        report->cadence = simulator->run;
+      break;
+
+    case REWIND_TYPE_TERMINATOR:
+      report->terminators ++;
+      report->order += (simulator->phase != PHASE_AUDIO);
+      simulator->phase = PHASE_TERMINATED;
+      break;
+
+    case REWIND_TYPE_CLOSE:
+      report->order += (simulator->phase == PHASE_HEADER) || (simulator->phase == PHASE_AUDIO);
+      simulator->phase = PHASE_CLOSED;
+      simulator->authenticated = 0;
+      break;
+  }
+}
+
+static void* ExecuteSimulator(void* argument)
+{
+  struct Simulator* simulator = (struct Simulator*)argument;
+  struct RewindData* packet;
+  struct sockaddr_in6 address;
+  socklen_t size;
+  uint8_t buffer[BUFFER_SIZE];
+  ssize_t length;
+
+  packet = (struct RewindData*)buffer;
+
+  while (simulator->state != 0)
+  {
+    size = sizeof(struct sockaddr_in6);
+    length = recvfrom(simulator->handle, buffer, BUFFER_SIZE, 0, (struct sockaddr*)&address, &size);
+
+    if ((length < (ssize_t)sizeof(struct RewindData)) ||
+        (memcmp(packet->sign, REWIND_PROTOCOL_SIGN, REWIND_SIGN_LENGTH) != 0))
+      continue;
+
+    ProcessSimulatorData(simulator, &address, packet, length);
+    __atomic_add_fetch(&simulator->received, 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+struct Simulator* CreateSimulator()
+{
+  struct Simulator* simulator = (struct Simulator*)calloc(1, sizeof(struct Simulator));
+  struct sockaddr_in6 address;
+  struct timeval interval;
+  socklen_t size = sizeof(struct sockaddr_in6);
+
+  if (simulator == NULL)
+    return NULL;
+
+  memset(&address, 0, sizeof(struct sockaddr_in6));
+  address.sin6_family = AF_INET6;
+  address.sin6_addr   = in6addr_loopback;
+
+  interval.tv_sec  = 0;
+  interval.tv_usec = RECEIVE_TIMEOUT;
+
+  simulator->state  = 1;
+  simulator->handle = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+
+  if ((simulator->handle < 0) ||
+      (bind(simulator->handle, (struct sockaddr*)&address, sizeof(struct sockaddr_in6)) < 0) ||
+      (getsockname(simulator->handle, (struct sockaddr*)&address, &size) < 0) ||
+      (setsockopt(simulator->handle, SOL_SOCKET, SO_RCVTIMEO, &interval, sizeof(struct timeval)) < 0) ||
+      (pthread_create(&simulator->thread, NULL, ExecuteSimulator, simulator) != 0))
+  {
+    close(simulator->handle);
+    free(simulator);
+    return NULL;
+  }
+
+  sprintf(simulator->port, "%u", ntohs(address.sin6_port));
+
+  return simulator;
+}
+
+void ReleaseSimulator(struct Simulator* simulator)
+{
+  if (simulator != NULL)
+  {
+    simulator->state = 0;
+    pthread_join(simulator->thread, NULL);
+    close(simulator->handle);
+    free(simulator);
+  }
+}
+
+void SynchronizeSimulator(struct Simulator* simulator, uint64_t count)
+{
+  struct timespec interval;
+  size_t attempt = 0;
+
+  interval.tv_sec  = 0;
+  interval.tv_nsec = 10000;
+
+  // Give up after about 10 ms of real time, lost packets show up as sequence gaps
+
+  while ((__atomic_load_n(&simulator->received, __ATOMIC_ACQUIRE) < count) &&
+         (attempt < SYNCHRONIZE_LIMIT))
+  {
+    nanosleep(&interval, NULL);
+    attempt ++;
+  }
+}
+
+uint64_t CheckSimulatorReport(struct Simulator* simulator)
+{
+  struct SimulatorReport* report = &simulator->report;
+  uint64_t count = report->gaps + report->order;
+
+  count += (report->cadence > SIMULATOR_KEEP_ALIVE_LIMIT);
+
+  if (report->frames > 0)
+  {
+    count += (report->terminators != 1);
+    count += (report->headers < SIMULATOR_HEADER_COUNT);
+  }
+
+  return count;
+}
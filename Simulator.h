@@ -0,0 +1,58 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define SIMULATOR_KEEP_ALIVE_LIMIT  83
+#define SIMULATOR_HEADER_COUNT      3
+
+struct SimulatorReport
+{
+  uint64_t packets;
+  uint64_t headers;
+  uint64_t frames;
+  uint64_t terminators;
+  uint64_t keepalives;
+  uint64_t polls;
+  uint64_t gaps;      // Sequence numbers skipped or repeated
+  uint64_t order;     // Header, audio, terminator or close out of place
+  uint32_t cadence;   // Longest run of audio frames without keep-alive
+};
+
+// Local stand-in for BrandMeister server, answers login, keep-alive and
+// session poll and checks what the client transmits
+
+struct Simulator
+{
+  int handle;
+  char port[8];
+  pthread_t thread;
+  volatile int state;
+  volatile uint64_t received;
+
+  int authenticated;
+  int phase;
+  uint32_t numbers[2];
+  uint32_t run;
+
+  struct SimulatorReport report;
+};
+
+struct Simulator* CreateSimulator();
+void ReleaseSimulator(struct Simulator* simulator);
+
+// Waits until the stand-in has processed <count> packets
+void SynchronizeSimulator(struct Simulator* simulator, uint64_t count);
+uint64_t CheckSimulatorReport(struct Simulator* simulator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
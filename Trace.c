@@ -0,0 +1,379 @@
+#include "Trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TDMA_FRAME_DURATION     60
+#define REWIND_TYPE_TERMINATOR  (REWIND_TYPE_DMR_DATA_BASE + 2)
+
+#define CATEGORY_KEEP_ALIVE   0
+#define CATEGORY_LOGIN        1
+#define CATEGORY_CLOSE        2
+#define CATEGORY_POLL         3
+#define CATEGORY_HEADER       4
+#define CATEGORY_AUDIO        5
+#define CATEGORY_TERMINATOR   6
+#define CATEGORY_OTHER        7
+#define CATEGORY_COUNT        8
+
+#define CALL_STATE_IDLE       0
+#define CALL_STATE_HEADER     1
+#define CALL_STATE_AUDIO      2
+
+int OpenTrace(struct Trace* trace, const char* path, size_t capacity, uint64_t start)
+{
+  uint64_t count;
+  int handle;
+
+  memset(trace, 0, sizeof(struct Trace));
+
+  for (count = 1; count < capacity; count <<= 1);
+
+  trace->length = sizeof(struct TraceHeader) + count * sizeof(struct TraceRecord);
+
+  handle = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if ((handle < 0) ||
+      (posix_fallocate(handle, 0, trace->length) != 0))
+  {
+    close(handle);
+    return TRACE_ERROR_OPEN;
+  }
+
+  // Populate the mapping now, so recording never takes a page fault that has to allocate
+
+  trace->map = (uint8_t*)mmap(NULL, trace->length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, handle, 0);
+  close(handle);
+
+  if (trace->map == MAP_FAILED)
+  {
+    trace->map = NULL;
+    return TRACE_ERROR_OPEN;
+  }
+
+  trace->header  = (struct TraceHeader*)trace->map;
+  trace->records = (struct TraceRecord*)(trace->header + 1);
+  trace->mask    = count - 1;
+
+  memcpy(trace->header->sign, TRACE_SIGN_TEXT, TRACE_SIGN_SIZE);
+  trace->header->size     = htole32(sizeof(struct TraceRecord));
+  trace->header->capacity = htole32(count);
+  trace->header->start    = htole64(start);
+
+  return TRACE_ERROR_SUCCESS;
+}
+
+void CloseTrace(struct Trace* trace)
+{
+  if (trace->map != NULL)
+  {
+    msync(trace->map, trace->length, MS_ASYNC);
+    munmap(trace->map, trace->length);
+    trace->map = NULL;
+  }
+}
+
+// Analyzer
+
+struct TraceTiming
+{
+  uint64_t count;
+  uint64_t minimum;
+  uint64_t maximum;
+  double sum;
+  double squares;
+};
+
+struct TraceReport
+{
+  uint64_t records;
+  uint64_t first;
+  uint64_t last;
+  uint64_t counts[2][CATEGORY_COUNT];
+  uint64_t failures;
+
+  uint64_t gaps[2];       // Sequence breaks of sent control and real-time packets
+  uint64_t jump;          // Largest sequence break
+
+  uint64_t run;           // Audio packets sent since the last keep-alive
+  uint64_t cadence;       // Longest such run
+  uint64_t interval;      // Longest time between keep-alives sent during a call
+  uint64_t unanswered;    // Keep-alives sent before the previous one was answered
+
+  uint64_t calls;
+  uint64_t headerless;    // Audio packets sent outside a call
+  uint64_t nested;        // Headers sent in the middle of a call
+  uint64_t orphans;       // Terminators sent outside a call
+  int open;               // Trace ends in the middle of a call
+
+  struct TraceTiming frames;  // Time between audio packets of a call
+  struct TraceTiming trips;   // Keep-alive round trips
+  uint64_t late;              // Audio packets more than half a period late
+  uint64_t early;             // Audio packets more than half a period early
+};
+
+static int GetTraceCategory(uint16_t type)
+{
+  switch (type)
+  {
+    case REWIND_TYPE_KEEP_ALIVE:      return CATEGORY_KEEP_ALIVE;
+    case REWIND_TYPE_CHALLENGE:
+    case REWIND_TYPE_AUTHENTICATION:  return CATEGORY_LOGIN;
+    case REWIND_TYPE_CLOSE:           return CATEGORY_CLOSE;
+    case REWIND_TYPE_SESSION_POLL:    return CATEGORY_POLL;
+    case REWIND_TYPE_SUPER_HEADER:    return CATEGORY_HEADER;
+    case REWIND_TYPE_DMR_AUDIO_FRAME: return CATEGORY_AUDIO;
+    case REWIND_TYPE_TERMINATOR:      return CATEGORY_TERMINATOR;
+  }
+
+  return CATEGORY_OTHER;
+}
+
+static void AddTraceTiming(struct TraceTiming* timing, uint64_t value)
+{
+  if ((timing->count == 0) ||
+      (timing->minimum > value))
+    timing->minimum = value;
+  if (timing->maximum < value)
+    timing->maximum = value;
+
+  timing->count   ++;
+  timing->sum     += value;
+  timing->squares += (double)value * value;
+}
+
+static void PrintTraceTiming(const char* name, struct TraceTiming* timing)
+{
+  double mean;
+  double deviation;
+
+  if (timing->count == 0)
+  {
+    printf("%s: no samples\n", name);
+    return;
+  }
+
+  mean      = timing->sum / timing->count;
+  deviation = sqrt(fmax(timing->squares / timing->count - mean * mean, 0.0));
+
+  printf("%s: %llu samples, mean %.3f ms, deviation %.3f ms, minimum %.3f ms, maximum %.3f ms\n",
+    name,
+    (unsigned long long)timing->count,
+    mean / 1e6,
+    deviation / 1e6,
+    timing->minimum / 1e6,
+    timing->maximum / 1e6);
+}
+
+static void AnalyzeTrace(struct TraceReport* report, const struct TraceRecord* records, uint64_t capacity, uint64_t position)
+{
+  const struct TraceRecord* record;
+  uint64_t expected[2];
+  uint64_t index;
+  uint64_t time;
+  uint64_t number;
+  uint64_t sent[2] = { 0, 0 };     // Last audio packet and keep-alive sent
+  uint64_t probe = 0;              // Keep-alive waiting for an answer
+  int seen[2] = { 0, 0 };
+  int state = CALL_STATE_IDLE;
+  int category;
+  int class;
+
+  index = (position > capacity) ? (position - capacity) : 0;
+
+  for (; index < position; index ++)
+  {
+    record   = records + index % capacity;
+    time     = le64toh(record->time);
+    category = GetTraceCategory(le16toh(record->type));
+
+    if (report->records == 0)
+      report->first = time;
+
+    report->last = time;
+    report->records ++;
+    report->counts[record->direction & 1][category] ++;
+
+    if (record->direction == TRACE_DIRECTION_RECEIVE)
+    {
+      if ((category == CATEGORY_KEEP_ALIVE) &&
+          (probe != 0))
+      {
+        AddTraceTiming(&report->trips, time - probe);
+        probe = 0;
+      }
+      continue;
+    }
+
+    report->failures += (record->result & TRACE_FLAG_FAILED) != 0;
+
+    // Sequence numbers are counted separately for control and real-time packets
+
+    class  = le16toh(record->flags) & REWIND_FLAG_REAL_TIME_1;
+    number = le32toh(record->number);
+
+    if ((seen[class] != 0) &&
+        (number != expected[class]))
+    {
+      report->gaps[class] ++;
+      if (report->jump < (uint32_t)(number - expected[class]))
+        report->jump = (uint32_t)(number - expected[class]);
+    }
+
+    seen[class]     = 1;
+    expected[class] = (uint32_t)(number + 1);
+
+    switch (category)
+    {
+      case CATEGORY_KEEP_ALIVE:
+        if ((state == CALL_STATE_AUDIO) &&
+            (sent[1] != 0) &&
+            (report->interval < (time - sent[1])))
+          report->interval = time - sent[1];
+        report->unanswered += (probe != 0);
+        report->run = 0;
+        sent[1] = time;
+        probe   = time;
+        break;
+
+      case CATEGORY_HEADER:
+        report->nested += (state == CALL_STATE_AUDIO);
+        state = CALL_STATE_HEADER;
+        break;
+
+      case CATEGORY_AUDIO:
+        if (state == CALL_STATE_IDLE)
+          report->headerless ++;
+
+        if (state == CALL_STATE_AUDIO)
+        {
+          // Packets are due every 60 ms, half a period either way counts as jitter
+          AddTraceTiming(&report->frames, time - sent[0]);
+          report->late  += (time - sent[0]) > (TDMA_FRAME_DURATION * 3 / 2 * 1000000ULL);
+          report->early += (time - sent[0]) < (TDMA_FRAME_DURATION / 2 * 1000000ULL);
+        }
+
+        report->run ++;
+        if (report->cadence < report->run)
+          report->cadence = report->run;
+
+        state   = CALL_STATE_AUDIO;
+        sent[0] = time;
+        break;
+
+      case CATEGORY_TERMINATOR:
+        report->orphans += (state == CALL_STATE_IDLE);
+        report->calls   += (state != CALL_STATE_IDLE);
+        state = CALL_STATE_IDLE;
+        break;
+    }
+  }
+
+  report->open = (state != CALL_STATE_IDLE);
+}
+
+int RunTraceAnalysis(int argc, char* argv[])
+{
+  static const char* names[] = { "keep-alive", "login", "close", "session poll", "header", "audio", "terminator", "other" };
+
+  struct TraceReport report;
+  struct TraceHeader* header;
+  struct stat status;
+  uint64_t capacity;
+  uint64_t position;
+  uint8_t* map;
+  size_t index;
+  int handle;
+  int problems;
+
+  if (argc < 2)
+  {
+    printf(
+      "Usage:\n"
+      "  digestplay trace <trace file written with --trace>\n"
+      "\n");
+    return EXIT_FAILURE;
+  }
+
+  handle = open(argv[1], O_RDONLY);
+
+  if ((handle < 0) ||
+      (fstat(handle, &status) < 0) ||
+      (status.st_size < sizeof(struct TraceHeader)) ||
+      ((map = (uint8_t*)mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, handle, 0)) == MAP_FAILED))
+  {
+    printf("%s: ERROR cannot read file\n", argv[1]);
+    close(handle);
+    return EXIT_FAILURE;
+  }
+
+  close(handle);
+
+  header   = (struct TraceHeader*)map;
+  capacity = le32toh(header->capacity);
+  position = le64toh(header->position);
+
+  if ((memcmp(header->sign, TRACE_SIGN_TEXT, TRACE_SIGN_SIZE) != 0) ||
+      (le32toh(header->size) != sizeof(struct TraceRecord)) ||
+      (capacity == 0) ||
+      (status.st_size < (sizeof(struct TraceHeader) + capacity * sizeof(struct TraceRecord))))
+  {
+    printf("%s: ERROR not a trace file\n", argv[1]);
+    munmap(map, status.st_size);
+    return EXIT_FAILURE;
+  }
+
+  memset(&report, 0, sizeof(struct TraceReport));
+  AnalyzeTrace(&report, (struct TraceRecord*)(header + 1), capacity, position);
+  munmap(map, status.st_size);
+
+  printf("%s: %llu records over %.3f s%s\n",
+    argv[1],
+    (unsigned long long)report.records,
+    (report.last - report.first) / 1e9,
+    (position > capacity) ? " (older records were overwritten)" : "");
+
+  printf("%-14s %10s %10s\n", "Packets", "sent", "received");
+  for (index = 0; index < CATEGORY_COUNT; index ++)
+    if ((report.counts[0][index] + report.counts[1][index]) > 0)
+      printf("%-14s %10llu %10llu\n", names[index], (unsigned long long)report.counts[0][index], (unsigned long long)report.counts[1][index]);
+
+  printf("Sequence gaps: %llu control, %llu real-time (largest jump %llu), %llu sends failed\n",
+    (unsigned long long)report.gaps[0],
+    (unsigned long long)report.gaps[1],
+    (unsigned long long)report.jump,
+    (unsigned long long)report.failures);
+  printf("Keep-alive cadence: longest run of %llu audio packets, longest interval during a call %.3f s, %llu sent before the previous was answered\n",
+    (unsigned long long)report.cadence,
+    report.interval / 1e9,
+    (unsigned long long)report.unanswered);
+  printf("Calls: %llu terminated, %llu audio packets without header, %llu headers inside a call, %llu terminators outside a call%s\n",
+    (unsigned long long)report.calls,
+    (unsigned long long)report.headerless,
+    (unsigned long long)report.nested,
+    (unsigned long long)report.orphans,
+    report.open ? ", last call not terminated" : "");
+
+  PrintTraceTiming("Inter-frame time", &report.frames);
+  printf("Audio packets more than %u ms late: %llu, more than %u ms early: %llu\n",
+    TDMA_FRAME_DURATION / 2,
+    (unsigned long long)report.late,
+    TDMA_FRAME_DURATION / 2,
+    (unsigned long long)report.early);
+  PrintTraceTiming("Keep-alive round trip", &report.trips);
+
+  problems =
+    report.gaps[0] + report.gaps[1] +
+    report.headerless + report.nested + report.orphans + report.open +
+    (report.cadence > (REWIND_KEEP_ALIVE_INTERVAL * 1000 / TDMA_FRAME_DURATION));
+
+  return (problems == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <endian.h>
+
+#include "Rewind.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TRACE_SIGN_TEXT  "DPTRC001"
+#define TRACE_SIGN_SIZE  8
+
+#define TRACE_ERROR_SUCCESS      0
+#define TRACE_ERROR_OPEN        -1
+#define TRACE_ERROR_FORMAT      -2
+
+#define TRACE_DIRECTION_SEND     0
+#define TRACE_DIRECTION_RECEIVE  1
+
+#define TRACE_FLAG_FAILED        1  // Packet was refused by the kernel
+
+#define TRACE_DEFAULT_CAPACITY   262144  // Records, about four hours of playout
+
+// Ring file, all values are little-endian: header, then <capacity> records.
+// Record <n> is stored at <n> % <capacity>, <position> is the number of records
+// ever written, so the oldest record kept is max(0, <position> - <capacity>).
+
+struct TraceHeader
+{
+  char sign[TRACE_SIGN_SIZE];
+  uint32_t size;      // Size of a record
+  uint32_t capacity;  // Number of records
+  uint64_t position;  // Records written
+  uint64_t start;     // Time of opening, same clock as records
+  uint8_t reserved[32];
+};
+
+// Copy of the transport header of one packet, type, flags, number and length are kept in wire order
+
+struct TraceRecord
+{
+  uint64_t time;      // Nanoseconds, monotonic or virtual clock of the context
+  uint16_t type;
+  uint16_t flags;
+  uint32_t number;
+  uint16_t length;
+  uint8_t direction;  // TRACE_DIRECTION_*
+  uint8_t result;     // TRACE_FLAG_*
+  uint32_t reserved;
+};
+
+struct Trace
+{
+  uint8_t* map;
+  size_t length;
+
+  struct TraceHeader* header;
+  struct TraceRecord* records;
+  uint64_t mask;      // Capacity minus one, capacity is a power of two
+  uint64_t position;
+};
+
+// Creates or truncates the file and maps it shared, every page is allocated up front,
+// <capacity> is rounded up to a power of two
+int OpenTrace(struct Trace* trace, const char* path, size_t capacity, uint64_t start);
+void CloseTrace(struct Trace* trace);
+
+// Hot path: one 24-byte store into the mapping, the kernel writes pages back on its own
+
+static inline void RecordTrace(struct Trace* trace, int direction, const struct RewindData* data, uint64_t time, int result)
+{
+  struct TraceRecord* record = trace->records + (trace->position & trace->mask);
+
+  record->time      = htole64(time);
+  record->type      = data->type;
+  record->flags     = data->flags;
+  record->number    = data->number;
+  record->length    = data->length;
+  record->direction = direction;
+  record->result    = result;
+
+  trace->position ++;
+  trace->header->position = htole64(trace->position);
+}
+
+// Entry point of "digestplay trace <file>"
+int RunTraceAnalysis(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
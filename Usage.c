@@ -0,0 +1,231 @@
+#include "Usage.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include "Log.h"
+
+#define NANOSECONDS_PER_SECOND        1000000000ULL
+#define NANOSECONDS_PER_MICROSECOND   1000ULL
+
+#define PACKET_DURATION  (60 * 1000000ULL)
+
+static const char* const tracepoints[] =
+{
+  "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+  "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+  NULL
+};
+
+static int OpenUsageCounter(uint32_t type, uint64_t config)
+{
+#ifdef __linux__
+  struct perf_event_attr attribute;
+
+  // Count the whole process including threads started later, user space only
+  // unless kernel events are explicitly requested by tracepoint
+
+  memset(&attribute, 0, sizeof(struct perf_event_attr));
+  attribute.size           = sizeof(struct perf_event_attr);
+  attribute.type           = type;
+  attribute.config         = config;
+  attribute.inherit        = 1;
+  attribute.exclude_kernel = (type != PERF_TYPE_TRACEPOINT);
+  attribute.exclude_hv     = 1;
+
+  return syscall(SYS_perf_event_open, &attribute, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+static int OpenSyscallCounter()
+{
+#ifdef __linux__
+  const char* const* path;
+  FILE* file;
+  long value = -1;
+
+  for (path = tracepoints; (*path != NULL) && (value < 0); path ++)
+    if ((file = fopen(*path, "r")) != NULL)
+    {
+      if (fscanf(file, "%ld", &value) != 1)
+        value = -1;
+      fclose(file);
+    }
+
+  if (value >= 0)
+    return OpenUsageCounter(PERF_TYPE_TRACEPOINT, value);
+#endif
+
+  return -1;
+}
+
+struct UsageMonitor* CreateUsageMonitor()
+{
+  struct UsageMonitor* monitor = (struct UsageMonitor*)calloc(1, sizeof(struct UsageMonitor));
+
+  if (monitor != NULL)
+  {
+#ifdef __linux__
+    monitor->handles[USAGE_COUNTER_CYCLES]       = OpenUsageCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    monitor->handles[USAGE_COUNTER_INSTRUCTIONS] = OpenUsageCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    monitor->handles[USAGE_COUNTER_MISSES]       = OpenUsageCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    monitor->handles[USAGE_COUNTER_SYSCALLS]     = OpenSyscallCounter();
+#else
+    memset(monitor->handles, -1, sizeof(monitor->handles));
+#endif
+  }
+
+  return monitor;
+}
+
+void ReleaseUsageMonitor(struct UsageMonitor* monitor)
+{
+  size_t index;
+
+  if (monitor != NULL)
+  {
+    for (index = 0; index < USAGE_COUNTER_COUNT; index ++)
+      if (monitor->handles[index] >= 0)
+        close(monitor->handles[index]);
+
+    free(monitor);
+  }
+}
+
+void TakeUsageSample(struct UsageMonitor* monitor, struct UsageSample* sample)
+{
+  struct timespec now;
+  struct rusage usage;
+  size_t index;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  getrusage(RUSAGE_SELF, &usage);
+
+  sample->time        = now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+  sample->cpu         = now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+  sample->user        = usage.ru_utime.tv_sec * NANOSECONDS_PER_SECOND + usage.ru_utime.tv_usec * NANOSECONDS_PER_MICROSECOND;
+  sample->system      = usage.ru_stime.tv_sec * NANOSECONDS_PER_SECOND + usage.ru_stime.tv_usec * NANOSECONDS_PER_MICROSECOND;
+  sample->voluntary   = usage.ru_nvcsw;
+  sample->involuntary = usage.ru_nivcsw;
+
+  for (index = 0; index < USAGE_COUNTER_COUNT; index ++)
+    if ((monitor->handles[index] < 0) ||
+        (read(monitor->handles[index], sample->counters + index, sizeof(uint64_t)) != sizeof(uint64_t)))
+      sample->counters[index] = 0;
+}
+
+void BeginUsagePhase(struct UsageMonitor* monitor)
+{
+  if (monitor != NULL)
+    TakeUsageSample(monitor, &monitor->start);
+}
+
+void EndUsagePhase(struct UsageMonitor* monitor, int phase)
+{
+  struct UsageSample sample;
+  struct UsageSample* total;
+  size_t index;
+
+  if (monitor != NULL)
+  {
+    TakeUsageSample(monitor, &sample);
+
+    total = monitor->phases + phase;
+
+    total->time        += sample.time        - monitor->start.time;
+    total->cpu         += sample.cpu         - monitor->start.cpu;
+    total->user        += sample.user        - monitor->start.user;
+    total->system      += sample.system      - monitor->start.system;
+    total->voluntary   += sample.voluntary   - monitor->start.voluntary;
+    total->involuntary += sample.involuntary - monitor->start.involuntary;
+
+    for (index = 0; index < USAGE_COUNTER_COUNT; index ++)
+      total->counters[index] += sample.counters[index] - monitor->start.counters[index];
+  }
+}
+
+void ReportUsage(struct UsageMonitor* monitor, uint64_t ticks, uint64_t packets)
+{
+  struct UsageSample* phase;
+  uint64_t cost;
+
+  if (monitor == NULL)
+    return;
+
+  phase = monitor->phases + USAGE_PHASE_CONNECT;
+  WriteLog(LOG_CATEGORY_REPORT,
+    "Connect: %lu us wall, %lu us CPU (%lu us system), %lu voluntary and %lu involuntary context switches\n",
+    (long)(phase->time / NANOSECONDS_PER_MICROSECOND),
+    (long)(phase->cpu / NANOSECONDS_PER_MICROSECOND),
+    (long)(phase->system / NANOSECONDS_PER_MICROSECOND),
+    (long)phase->voluntary,
+    (long)phase->involuntary);
+
+  phase = monitor->phases + USAGE_PHASE_WAIT;
+  if (phase->time > 0)
+    WriteLog(LOG_CATEGORY_REPORT,
+      "Waiting: %lu us wall, %lu us CPU (%lu us system), %lu voluntary and %lu involuntary context switches\n",
+      (long)(phase->time / NANOSECONDS_PER_MICROSECOND),
+      (long)(phase->cpu / NANOSECONDS_PER_MICROSECOND),
+      (long)(phase->system / NANOSECONDS_PER_MICROSECOND),
+      (long)phase->voluntary,
+      (long)phase->involuntary);
+
+  phase = monitor->phases + USAGE_PHASE_PLAYBACK;
+  WriteLog(LOG_CATEGORY_REPORT,
+    "Playback: %lu us wall, %lu us CPU (%lu us system), %lu voluntary and %lu involuntary context switches\n",
+    (long)(phase->time / NANOSECONDS_PER_MICROSECOND),
+    (long)(phase->cpu / NANOSECONDS_PER_MICROSECOND),
+    (long)(phase->system / NANOSECONDS_PER_MICROSECOND),
+    (long)phase->voluntary,
+    (long)phase->involuntary);
+
+  if ((packets == 0) ||
+      (ticks   == 0))
+    return;
+
+  // Rates are printed in thousandths to stay within integer log arguments
+
+  cost = phase->cpu / packets;
+
+  WriteLog(LOG_CATEGORY_REPORT,
+    "Playback: %lu ns CPU per packet (%lu ns system), %lu.%03lu wakeups per tick, about %lu streams per core\n",
+    (long)cost,
+    (long)(phase->system / packets),
+    (long)(phase->voluntary / ticks),
+    (long)(phase->voluntary * 1000 / ticks % 1000),
+    (long)((cost > 0) ? (PACKET_DURATION / cost) : 0));
+
+  if (monitor->handles[USAGE_COUNTER_SYSCALLS] >= 0)
+    WriteLog(LOG_CATEGORY_REPORT,
+      "Playback: %lu.%03lu syscalls per tick\n",
+      (long)(phase->counters[USAGE_COUNTER_SYSCALLS] / ticks),
+      (long)(phase->counters[USAGE_COUNTER_SYSCALLS] * 1000 / ticks % 1000));
+  else
+    WriteLog(LOG_CATEGORY_REPORT, "Playback: syscall counting is not available (needs perf_event_open and tracefs)\n");
+
+  if (monitor->handles[USAGE_COUNTER_CYCLES] >= 0)
+    WriteLog(LOG_CATEGORY_REPORT,
+      "Playback: %lu cycles, %lu instructions, %lu cache misses per packet\n",
+      (long)(phase->counters[USAGE_COUNTER_CYCLES] / packets),
+      (long)(phase->counters[USAGE_COUNTER_INSTRUCTIONS] / packets),
+      (long)(phase->counters[USAGE_COUNTER_MISSES] / packets));
+  else
+    WriteLog(LOG_CATEGORY_REPORT, "Playback: hardware counters are not available\n");
+}
@@ -0,0 +1,61 @@
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define USAGE_PHASE_CONNECT     0
+#define USAGE_PHASE_WAIT        1
+#define USAGE_PHASE_PLAYBACK    2
+#define USAGE_PHASE_COUNT       3
+
+#define USAGE_COUNTER_CYCLES        0
+#define USAGE_COUNTER_INSTRUCTIONS  1
+#define USAGE_COUNTER_MISSES        2
+#define USAGE_COUNTER_SYSCALLS      3
+#define USAGE_COUNTER_COUNT         4
+
+// Resource usage of the whole process, times are in nanoseconds
+
+struct UsageSample
+{
+  uint64_t time;         // Wall time (monotonic)
+  uint64_t cpu;          // CPU time of all threads (precise, unlike the rusage split below)
+  uint64_t user;         // CPU time in user mode
+  uint64_t system;       // CPU time in kernel mode
+  uint64_t voluntary;    // Context switches caused by waiting (wakeups)
+  uint64_t involuntary;  // Context switches caused by preemption
+  uint64_t counters[USAGE_COUNTER_COUNT];
+};
+
+// perf_event_open counters are optional, unavailable ones keep handle -1
+// (virtual machines often have no PMU, syscall counting needs tracefs)
+
+struct UsageMonitor
+{
+  int handles[USAGE_COUNTER_COUNT];
+  struct UsageSample start;
+  struct UsageSample phases[USAGE_PHASE_COUNT];
+};
+
+struct UsageMonitor* CreateUsageMonitor();
+void ReleaseUsageMonitor(struct UsageMonitor* monitor);
+
+void TakeUsageSample(struct UsageMonitor* monitor, struct UsageSample* sample);
+
+// Phases may be entered several times, usage is accumulated; all calls accept NULL
+void BeginUsagePhase(struct UsageMonitor* monitor);
+void EndUsagePhase(struct UsageMonitor* monitor, int phase);
+
+// Writes totals per phase and playback cost per packet (<packets>) and per timer event (<ticks>)
+void ReportUsage(struct UsageMonitor* monitor, uint64_t ticks, uint64_t packets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif